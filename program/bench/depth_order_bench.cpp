@@ -0,0 +1,87 @@
+// times keeping sprites in far to near order as the camera moves, against a
+// fresh std::sort through per-entity distance pointers every frame
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../depth_order.h"
+
+#define FRAMES 100
+
+struct Distance {
+    float distance;
+};
+
+static void update_distances( const std::vector<float>& xs, const std::vector<float>& ys,
+    std::vector<Distance>& distances, const float camera_x, const float camera_y ) {
+    for ( size_t i = 0; i < xs.size(); i++ ) {
+        const float dx = xs[ i ] - camera_x;
+        const float dy = ys[ i ] - camera_y;
+        distances[ i ].distance = std::sqrt( dx * dx + dy * dy );
+    }
+}
+
+// camera_step is how far the camera moves each frame, bigger steps are less
+// coherent
+static void run( const size_t count, const float camera_step ) {
+    std::mt19937 rng( 99 );
+    std::uniform_real_distribution<float> position( 0, 512 );
+
+    std::vector<float> xs( count ), ys( count );
+    for ( size_t i = 0; i < count; i++ ) {
+        xs[ i ] = position( rng );
+        ys[ i ] = position( rng );
+    }
+
+    std::vector<Distance> distances( count );
+    std::vector<Distance*> components( count );
+    std::vector<uint32_t> ids( count );
+    DepthOrder order;
+    for ( size_t i = 0; i < count; i++ ) {
+        components[ i ] = &distances[ i ];
+        ids[ i ] = i;
+        order.add( i );
+    }
+
+    double sort_ms = 0, order_ms = 0;
+    for ( int frame = 0; frame < FRAMES; frame++ ) {
+        update_distances( xs, ys, distances, 256 + frame * camera_step, 256 );
+
+        auto start = std::chrono::steady_clock::now();
+        std::sort( ids.begin(), ids.end(), [&]( uint32_t a, uint32_t b ) {
+            return components[ a ]->distance > components[ b ]->distance;
+        } );
+        auto end = std::chrono::steady_clock::now();
+        sort_ms += std::chrono::duration<double, std::milli>( end - start ).count();
+
+        start = std::chrono::steady_clock::now();
+        for ( auto& entry : order.get_entries() ) {
+            entry.key = DepthOrder::make_key( components[ entry.item ]->distance );
+        }
+        order.sort();
+        end = std::chrono::steady_clock::now();
+        order_ms += std::chrono::duration<double, std::milli>( end - start ).count();
+    }
+
+    const auto& entries = order.get_entries();
+    bool sorted = true;
+    for ( size_t i = 1; i < entries.size(); i++ ) {
+        if ( distances[ entries[ i - 1 ].item ].distance < distances[ entries[ i ].item ].distance ) sorted = false;
+    }
+
+    printf( "  %6zu sprites, camera step %5.2f: std::sort %.3f ms  depth order %.3f ms  (%zu radix, %s)\n",
+        count, camera_step, sort_ms / FRAMES, order_ms / FRAMES, order.get_radix_sort_count(),
+        sorted ? "ok" : "NOT SORTED" );
+}
+
+int main() {
+    printf( "sprite depth ordering, %d frames\n", FRAMES );
+    for ( size_t count : { 1000, 10000, 50000 } ) {
+        run( count, 0.05f );
+        run( count, 5.0f );
+    }
+    return 0;
+}
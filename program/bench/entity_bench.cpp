@@ -0,0 +1,85 @@
+// times registering and unregistering entities: filling every slot, emptying
+// it again, refilling from the free list, then a steady churn like enemies
+// spawning and dying. also walks a component through its packed array against
+// looking each one up, and checks every stale handle is caught
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../entity_engine.h"
+#include "../components.h"
+
+static double ns_per_op( const std::chrono::steady_clock::time_point start, const size_t ops ) {
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>( end - start ).count() / ops;
+}
+
+int main() {
+    EntityEngine entities;
+    std::vector<Entity> live;
+    live.reserve( MAX_ENTITIES );
+
+    auto start = std::chrono::steady_clock::now();
+    while ( auto id = entities.register_entity() ) live.push_back( id.value() );
+    printf( "register %zu fresh:      %.1f ns each\n", live.size(), ns_per_op( start, live.size() ) );
+
+    start = std::chrono::steady_clock::now();
+    for ( auto id : live ) entities.add_component( id, MovementComponent { float(id & 0xFF), 0.0f, 1.0f } );
+    printf( "add component to %zu:    %.1f ns each\n", live.size(), ns_per_op( start, live.size() ) );
+
+    auto& movement = entities.get_components<MovementComponent>();
+    float sum = 0;
+    start = std::chrono::steady_clock::now();
+    for ( size_t i = 0; i < movement.size(); i++ ) sum += movement[ i ].x * movement[ i ].speed;
+    printf( "walk %zu packed:         %.2f ns each\n", movement.size(), ns_per_op( start, movement.size() ) );
+
+    // the order a system would meet them in if it went through its own list
+    std::vector<Entity> shuffled = live;
+    std::shuffle( shuffled.begin(), shuffled.end(), std::mt19937( 1 ) );
+    start = std::chrono::steady_clock::now();
+    for ( auto id : shuffled ) {
+        const auto move_comp = entities.get_component<MovementComponent>( id );
+        sum += move_comp->x * move_comp->speed;
+    }
+    printf( "look up %zu by handle:   %.2f ns each  (%.0f)\n", shuffled.size(), ns_per_op( start, shuffled.size() ), sum );
+
+    const std::vector<Entity> stale = live;
+    start = std::chrono::steady_clock::now();
+    for ( auto id : live ) entities.unregister_entity( id );
+    printf( "unregister %zu:          %.1f ns each\n", live.size(), ns_per_op( start, live.size() ) );
+
+    live.clear();
+    start = std::chrono::steady_clock::now();
+    while ( auto id = entities.register_entity() ) live.push_back( id.value() );
+    printf( "register %zu from free:  %.1f ns each\n", live.size(), ns_per_op( start, live.size() ) );
+
+    // every handle from the first round should now be refused
+    size_t caught = 0;
+    for ( auto id : stale ) {
+        caught += !entities.is_alive( id ) && !entities.get_component<MovementComponent>( id )
+            && !entities.unregister_entity( id );
+    }
+    printf( "stale handles caught:       %zu of %zu\n", caught, stale.size() );
+
+    // a live population of 100k with random ones dying and being replaced,
+    // each with a component to add and take away
+    for ( size_t i = 100000; i < live.size(); i++ ) entities.unregister_entity( live[ i ] );
+    live.resize( 100000 );
+    for ( auto id : live ) entities.add_component( id, MovementComponent { 0.0f, 0.0f, 1.0f } );
+
+    std::mt19937 rng( 5 );
+    const size_t churn = 10000000;
+    start = std::chrono::steady_clock::now();
+    for ( size_t i = 0; i < churn; i++ ) {
+        Entity& slot = live[ rng() % live.size() ];
+        entities.unregister_entity( slot );
+        slot = entities.register_entity().value();
+        entities.add_component( slot, MovementComponent { 0.0f, 0.0f, 1.0f } );
+    }
+    printf( "churn %zu at %zu live:  %.1f ns per unregister, register and add\n",
+        churn, entities.get_count(), ns_per_op( start, churn ) );
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+// times the floor/ceiling row kernel on its own, outside of the engine
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include <thread>
+
+#include "../render_kernels.h"
+#include "../worker_pool.h"
+
+#define VIEW_WIDTH 512
+#define VIEW_HEIGHT 512
+#define TEX_SIZE 64
+#define FRAMES 200
+
+static double run( FloorRowKernel kernel, WorkerPool& pool, std::vector<Color>& target,
+    const std::vector<Color>& texels, const std::vector<float>& tans,
+    const std::vector<int>& floor_start, const std::vector<int>& ceiling_end ) {
+    const auto start = std::chrono::steady_clock::now();
+
+    for ( int frame = 0; frame < FRAMES; frame++ ) {
+        const float angle = frame * 0.01f;
+        const float forward_x = std::cos( angle );
+        const float forward_y = std::sin( angle );
+
+        pool.parallel_for( VIEW_HEIGHT / 2, [&]( const size_t begin, const size_t end ) {
+            uint32_t offsets[ VIEW_WIDTH ];
+            for ( size_t row = begin; row < end; row++ ) {
+                const int floor_y = VIEW_HEIGHT / 2 + row;
+                const int ceiling_y = VIEW_HEIGHT / 2 - 1 - row;
+                const float dist = VIEW_HEIGHT / (2 * (row + .5f));
+                kernel( &target[ floor_y * VIEW_WIDTH ], &target[ ceiling_y * VIEW_WIDTH ], VIEW_WIDTH,
+                    8 + forward_x * dist, 8 + forward_y * dist, -forward_y * dist, forward_x * dist,
+                    tans.data(), floor_start.data(), ceiling_end.data(), floor_y, ceiling_y,
+                    texels.data(), texels.data() + TEX_SIZE * TEX_SIZE, TEX_SIZE, nullptr, offsets );
+            }
+        } );
+    }
+
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>( end - start ).count() / FRAMES;
+}
+
+int main() {
+    std::vector<Color> texels( TEX_SIZE * TEX_SIZE * 2 );
+    for ( size_t i = 0; i < texels.size(); i++ ) texels[ i ] = Color( uint32_t(i * 2654435761u) | 0xFF );
+
+    std::vector<float> tans( VIEW_WIDTH );
+    for ( int i = 0; i < VIEW_WIDTH; i++ ) tans[ i ] = std::tan( -M_PI / 6 + (M_PI / 3) * i / VIEW_WIDTH );
+
+    // worst case: no walls at all, every pixel is floor or ceiling
+    std::vector<int> floor_start( VIEW_WIDTH, VIEW_HEIGHT / 2 );
+    std::vector<int> ceiling_end( VIEW_WIDTH, VIEW_HEIGHT / 2 );
+    std::vector<Color> target( VIEW_WIDTH * VIEW_HEIGHT );
+
+    const size_t hw_threads = std::max( 1u, std::thread::hardware_concurrency() );
+    WorkerPool single( 0 );
+    WorkerPool all( hw_threads - 1 );
+
+    const double pixels = VIEW_WIDTH * VIEW_HEIGHT;
+    const double pow2 = run( floor_row_kernel<6>, single, target, texels, tans, floor_start, ceiling_end );
+    const double generic = run( floor_row_kernel<0>, single, target, texels, tans, floor_start, ceiling_end );
+    const double threaded = run( floor_row_kernel<6>, all, target, texels, tans, floor_start, ceiling_end );
+
+    printf( "floor rows, %dx%d view, %d frames\n", VIEW_WIDTH, VIEW_HEIGHT, FRAMES );
+    printf( "  power of two, 1 thread:  %.3f ms/frame  %.2f ns/pixel\n", pow2, pow2 * 1e6 / pixels );
+    printf( "  generic, 1 thread:       %.3f ms/frame  %.2f ns/pixel\n", generic, generic * 1e6 / pixels );
+    printf( "  power of two, %zu threads: %.3f ms/frame  %.2f ns/pixel\n", all.get_thread_count(), threaded, threaded * 1e6 / pixels );
+
+    return 0;
+}
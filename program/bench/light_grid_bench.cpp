@@ -0,0 +1,85 @@
+// times moving lights around a big dynamic light grid, against rebuilding
+// the whole grid every frame
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../light_grid.h"
+
+#define MAP_SIZE 512
+#define FRAMES 200
+
+struct Mover {
+    int id;
+    float dx;
+    float dy;
+};
+
+// moves every nth light
+static void step( LightGrid& grid, std::vector<Mover>& movers, std::vector<Light>& lights, const int every ) {
+    for ( size_t i = 0; i < movers.size(); i += every ) {
+        auto& light = lights[ i ];
+        auto& mover = movers[ i ];
+        if ( light.x + mover.dx < 0 || light.x + mover.dx >= MAP_SIZE ) mover.dx = -mover.dx;
+        if ( light.y + mover.dy < 0 || light.y + mover.dy >= MAP_SIZE ) mover.dy = -mover.dy;
+        light.x += mover.dx;
+        light.y += mover.dy;
+        grid.move_light( mover.id, light.x, light.y );
+    }
+}
+
+static void run( const int light_count ) {
+    std::mt19937 rng( 1234 );
+    std::uniform_real_distribution<float> position( 0, MAP_SIZE );
+    std::uniform_real_distribution<float> velocity( -0.2f, 0.2f );
+    std::uniform_real_distribution<float> radius( 2, 8 );
+
+    LightGrid grid;
+    grid.resize( MAP_SIZE, MAP_SIZE );
+
+    std::vector<Light> lights;
+    std::vector<Mover> movers;
+    for ( int i = 0; i < light_count; i++ ) {
+        lights.push_back( Light { position( rng ), position( rng ), radius( rng ), 0.6f } );
+        movers.push_back( Mover { grid.add_light( lights.back() ), velocity( rng ), velocity( rng ) } );
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for ( int frame = 0; frame < FRAMES; frame++ ) step( grid, movers, lights, 1 );
+    auto end = std::chrono::steady_clock::now();
+    const double all_moving = std::chrono::duration<double, std::milli>( end - start ).count() / FRAMES;
+
+    start = std::chrono::steady_clock::now();
+    for ( int frame = 0; frame < FRAMES; frame++ ) step( grid, movers, lights, 10 );
+    end = std::chrono::steady_clock::now();
+    const double some_moving = std::chrono::duration<double, std::milli>( end - start ).count() / FRAMES;
+
+    start = std::chrono::steady_clock::now();
+    for ( int frame = 0; frame < FRAMES; frame++ ) grid.rebuild();
+    end = std::chrono::steady_clock::now();
+    const double rebuild = std::chrono::duration<double, std::milli>( end - start ).count() / FRAMES;
+
+    // one lookup per column of the view, like the wall pass does
+    std::uniform_int_distribution<int> cell( 0, MAP_SIZE * MAP_SIZE - 1 );
+    std::vector<int> cells( 512 );
+    for ( auto& c : cells ) c = cell( rng );
+
+    unsigned sum = 0;
+    start = std::chrono::steady_clock::now();
+    for ( int frame = 0; frame < FRAMES; frame++ ) {
+        for ( auto c : cells ) sum += grid.sample( c );
+    }
+    end = std::chrono::steady_clock::now();
+    const double reads = std::chrono::duration<double, std::micro>( end - start ).count() / FRAMES;
+
+    printf( "  %5d lights: all move %.3f ms  1 in 10 move %.3f ms  rebuild %.3f ms  512 reads %.2f us (%u)\n",
+        light_count, all_moving, some_moving, rebuild, reads, sum & 1 );
+}
+
+int main() {
+    printf( "dynamic light grid, %dx%d map, %d frames\n", MAP_SIZE, MAP_SIZE, FRAMES );
+    for ( int count : { 100, 250, 500, 1000 } ) run( count );
+    return 0;
+}
@@ -0,0 +1,59 @@
+// times the particle system at crowd scale: the update on its own thread, then
+// projecting, binning and drawing them with different numbers of threads
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "../particles.h"
+
+#define VIEW_WIDTH 512
+#define VIEW_HEIGHT 512
+#define FRAMES 100
+
+static void run( const size_t count, const size_t threads ) {
+    ParticleSystem particles;
+    const size_t bursts = 100;
+    for ( size_t b = 0; b < bursts; b++ ) {
+        // spread out over a room in front of the camera
+        particles.emit( ParticleBurst { 4.0f + (b % 10) * 0.8f, -4.0f + (b / 10) * 0.8f, 0.5f,
+            0.8f, 1000.0f, 0.03f, Color( 0xC8B496FF ), count / bursts } );
+    }
+
+    // a wall six units off, with a closer pillar in the middle
+    std::vector<float> wall_depth( VIEW_WIDTH, 6.0f );
+    for ( int x = VIEW_WIDTH / 2 - 40; x < VIEW_WIDTH / 2 + 40; x++ ) wall_depth[ x ] = 3.0f;
+
+    WorkerPool workers( threads - 1 );
+    ParticleBatch batch;
+    std::vector<Color> framebuffer( VIEW_WIDTH * VIEW_HEIGHT );
+    const ParticleView view { 0, 0, 1, 0, VIEW_WIDTH / float(M_PI / 3), VIEW_WIDTH / 2, VIEW_WIDTH, VIEW_HEIGHT };
+
+    double update_ms = 0, build_ms = 0, draw_ms = 0;
+    for ( int frame = 0; frame < FRAMES; frame++ ) {
+        auto start = std::chrono::steady_clock::now();
+        particles.update( 1 / 60.0f );
+        auto end = std::chrono::steady_clock::now();
+        update_ms += std::chrono::duration<double, std::milli>( end - start ).count();
+
+        start = std::chrono::steady_clock::now();
+        batch.build( particles, view, nullptr, nullptr, workers );
+        end = std::chrono::steady_clock::now();
+        build_ms += std::chrono::duration<double, std::milli>( end - start ).count();
+
+        start = std::chrono::steady_clock::now();
+        batch.draw( framebuffer.data(), VIEW_WIDTH, wall_depth.data(), workers );
+        end = std::chrono::steady_clock::now();
+        draw_ms += std::chrono::duration<double, std::milli>( end - start ).count();
+    }
+
+    printf( "  %7zu particles, %zu threads: update %.3f ms  project and bin %.3f ms  draw %.3f ms  (%zu drawn)\n",
+        particles.get_count(), threads, update_ms / FRAMES, build_ms / FRAMES, draw_ms / FRAMES, batch.get_drawn_count() );
+}
+
+int main() {
+    printf( "particles, %dx%d view, %d frames\n", VIEW_WIDTH, VIEW_HEIGHT, FRAMES );
+    for ( size_t threads : { 1, 2, 4 } ) run( 100000, threads );
+    run( 400000, 4 );
+    return 0;
+}
@@ -0,0 +1,105 @@
+// times drawing a crowd of sprites straight from the texture, against copying
+// them out of the pre-scaled sprite cache. run from the program directory so
+// the enemy texture can be found
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../render_kernels.h"
+#include "../sprite_cache.h"
+
+#define VIEW_WIDTH 512
+#define VIEW_HEIGHT 512
+#define FRAMES 200
+
+struct Placed {
+    size_t type;
+    int size;
+    int x;
+};
+
+static void draw_direct( Texture& texture, const std::vector<Placed>& sprites, Color* target,
+    const SpriteColumnKernel kernel, const ShadeLevel* shade ) {
+    const size_t tex_size = texture.get_size();
+    for ( auto& s : sprites ) {
+        const int v_offset = VIEW_HEIGHT / 2 - s.size / 2;
+        for ( int i = std::max( 0, -s.x ); i < s.size && s.x + i < VIEW_WIDTH; i++ ) {
+            const size_t tex_x = i * tex_size / s.size;
+            size_t span_count;
+            const auto spans = texture.get_column_spans( s.type, tex_x, span_count );
+            if ( span_count == 0 ) continue;
+            kernel( &target[ s.x + i ], VIEW_WIDTH, texture.get_column_data( s.type, tex_x ), spans, span_count,
+                tex_size, s.size, v_offset, VIEW_HEIGHT, shade, nullptr );
+        }
+    }
+}
+
+static void draw_cached( Texture& texture, SpriteCache& cache, const std::vector<Placed>& sprites, Color* target,
+    const ShadeLevel* shade ) {
+    for ( auto& s : sprites ) {
+        const int v_offset = VIEW_HEIGHT / 2 - s.size / 2;
+        const ScaledSprite* scaled = cache.get( texture, s.type, s.size );
+        for ( int i = std::max( 0, -s.x ); i < s.size && s.x + i < VIEW_WIDTH; i++ ) {
+            size_t span_count;
+            const auto spans = scaled->get_column_spans( i, span_count );
+            if ( span_count == 0 ) continue;
+            scaled_sprite_column_kernel( &target[ s.x + i ], VIEW_WIDTH, &scaled->pixels[ scaled->pixel_offsets[ i ] ],
+                spans, span_count, v_offset, VIEW_HEIGHT, shade, (uint64_t*)nullptr );
+        }
+    }
+}
+
+static void run( Texture& texture, const size_t count, const int min_size, const int max_size ) {
+    std::mt19937 rng( 3 );
+    std::uniform_int_distribution<int> size( min_size, max_size );
+    std::uniform_int_distribution<int> type( 0, texture.get_count() - 1 );
+
+    std::vector<Placed> sprites( count );
+    std::vector<Color> framebuffer( VIEW_WIDTH * VIEW_HEIGHT );
+    const SpriteColumnKernel kernel = pick_sprite_column_kernel( texture.get_size() );
+    const ShadeLevel shade = { 200, 0, 0 };
+
+    SpriteCache cache;
+    double direct_ms = 0, cached_ms = 0;
+    for ( int frame = 0; frame < FRAMES; frame++ ) {
+        // sizes and places drift a little between frames, like a crowd walking
+        for ( auto& s : sprites ) {
+            s.type = type( rng );
+            s.size = SpriteCache::quantize_size( size( rng ) );
+            s.x = int(rng() % (VIEW_WIDTH + s.size)) - s.size;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        draw_direct( texture, sprites, framebuffer.data(), kernel, &shade );
+        auto end = std::chrono::steady_clock::now();
+        direct_ms += std::chrono::duration<double, std::milli>( end - start ).count();
+
+        start = std::chrono::steady_clock::now();
+        draw_cached( texture, cache, sprites, framebuffer.data(), &shade );
+        cache.trim();
+        end = std::chrono::steady_clock::now();
+        cached_ms += std::chrono::duration<double, std::milli>( end - start ).count();
+    }
+
+    const auto stats = cache.get_stats();
+    printf( "  %5zu sprites %3d - %3d px: direct %.3f ms  cached %.3f ms  hit rate %.1f%%  %zu entries %.1f MB\n",
+        count, min_size, max_size, direct_ms / FRAMES, cached_ms / FRAMES,
+        100.0 * stats.hits / (stats.hits + stats.misses), stats.entries, stats.bytes / (1024.0 * 1024.0) );
+}
+
+int main() {
+    // the cache keeps palette indices alongside the colours
+    Texture texture( "assets/enemies.png" );
+    Palette palette;
+    texture.add_to_palette( palette );
+    palette.build( {} );
+    texture.build_indices( palette );
+
+    printf( "sprite crowd, %dx%d view, %d frames\n", VIEW_WIDTH, VIEW_HEIGHT, FRAMES );
+    run( texture, 1000, 8, 32 );
+    run( texture, 1000, 16, 64 );
+    run( texture, 200, 64, 128 );
+    run( texture, 100, 96, 128 );
+    return 0;
+}
@@ -0,0 +1,67 @@
+// times getting sprites into screen space: the old atan2 per sprite with the
+// angle wrapped by hand, against the batched camera space transform
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../render_kernels.h"
+
+#define VIEW_WIDTH 512
+#define FRAMES 200
+
+static void run( const size_t count ) {
+    std::mt19937 rng( 7 );
+    std::uniform_real_distribution<float> position( 0, 512 );
+
+    std::vector<float> xs( count ), ys( count );
+    for ( size_t i = 0; i < count; i++ ) {
+        xs[ i ] = position( rng );
+        ys[ i ] = position( rng );
+    }
+
+    const float fov = M_PI / 3;
+    std::vector<float> old_screen_x( count ), old_distance( count );
+    std::vector<float> depth( count ), distance( count ), screen_x( count );
+
+    double old_ms = 0, batch_ms = 0;
+    float worst = 0;
+    for ( int frame = 0; frame < FRAMES; frame++ ) {
+        const float camera_x = 256 + frame * 0.1f;
+        const float camera_y = 256;
+        const float view_angle = frame * 0.05f;
+
+        auto start = std::chrono::steady_clock::now();
+        for ( size_t i = 0; i < count; i++ ) {
+            float dir = std::atan2( ys[ i ] - camera_y, xs[ i ] - camera_x );
+            while ( dir - view_angle > M_PI ) dir -= 2 * M_PI;
+            while ( dir - view_angle < -M_PI ) dir += 2 * M_PI;
+            old_screen_x[ i ] = (dir - view_angle) / fov * VIEW_WIDTH + VIEW_WIDTH / 2;
+            old_distance[ i ] = std::sqrt( std::pow( xs[ i ] - camera_x, 2 ) + std::pow( ys[ i ] - camera_y, 2 ) );
+        }
+        auto end = std::chrono::steady_clock::now();
+        old_ms += std::chrono::duration<double, std::milli>( end - start ).count();
+
+        start = std::chrono::steady_clock::now();
+        project_sprite_batch( count, xs.data(), ys.data(), camera_x, camera_y,
+            std::cos( view_angle ), std::sin( view_angle ), VIEW_WIDTH / fov, VIEW_WIDTH / 2,
+            depth.data(), distance.data(), screen_x.data() );
+        end = std::chrono::steady_clock::now();
+        batch_ms += std::chrono::duration<double, std::milli>( end - start ).count();
+
+        // only sprites in front of the camera get drawn
+        for ( size_t i = 0; i < count; i++ ) {
+            if ( depth[ i ] > 0 ) worst = std::max( worst, std::abs( screen_x[ i ] - old_screen_x[ i ] ) );
+        }
+    }
+
+    printf( "  %6zu sprites: atan2 %.3f ms  batched %.3f ms  worst column error %.4f\n",
+        count, old_ms / FRAMES, batch_ms / FRAMES, worst );
+}
+
+int main() {
+    printf( "sprite camera space transform, %d frames\n", FRAMES );
+    for ( size_t count : { 1000, 10000, 50000 } ) run( count );
+    return 0;
+}
@@ -0,0 +1,28 @@
+#include "cell_set.h"
+
+#include <algorithm>
+
+CellSet::CellSet() : width( 0 ), height( 0 ) {}
+
+void CellSet::resize( const int width, const int height ) {
+    this->width = width;
+    this->height = height;
+    bits.assign( (width * height + 63) / 64, 0 );
+}
+
+void CellSet::clear() {
+    std::fill( bits.begin(), bits.end(), 0 );
+}
+
+bool CellSet::contains_near( const float x, const float y ) const {
+    const int cell_x = x;
+    const int cell_y = y;
+
+    for ( int ny = std::max( 0, cell_y - 1 ); ny <= std::min( height - 1, cell_y + 1 ); ny++ ) {
+        for ( int nx = std::max( 0, cell_x - 1 ); nx <= std::min( width - 1, cell_x + 1 ); nx++ ) {
+            if ( contains( nx + ny * width ) ) return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,33 @@
+#ifndef CELL_SET_H
+#define CELL_SET_H
+
+#include <vector>
+#include <cstdint>
+
+// one bit per map cell
+class CellSet {
+public:
+    CellSet();
+
+    void resize( const int width, const int height );
+    void clear();
+
+    inline void insert( const int cell ) {
+        bits[ cell >> 6 ] |= uint64_t(1) << (cell & 63);
+    }
+
+    inline bool contains( const int cell ) const {
+        return (bits[ cell >> 6 ] >> (cell & 63)) & 1;
+    }
+
+    // whether the cell holding x, y or any of its eight neighbours is in the
+    // set. things can poke out of their own cell, so this is the safe test
+    bool contains_near( const float x, const float y ) const;
+
+private:
+    int width;
+    int height;
+    std::vector<uint64_t> bits;
+};
+
+#endif
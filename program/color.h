@@ -5,13 +5,15 @@
 
 class Color {
 public:
+    // the hex accessors get hit for every pixel drawn, so they're defined here
+    // where they can be inlined
     Color();
-    Color( uint32_t hex );
+    Color( uint32_t hex ) : hex_value( hex ) {}
     Color( uint8_t r, uint8_t g, uint8_t b, uint8_t a );
-    void set_hex( uint32_t hex );
+    void set_hex( uint32_t hex ) { hex_value = hex; }
     void set_components( uint8_t r, uint8_t g, uint8_t b, uint8_t a );
-    uint32_t get_hex();
-    void get_components( uint8_t& r, uint8_t& g, uint8_t& b, uint8_t& a );
+    uint32_t get_hex() const { return hex_value; }
+    void get_components( uint8_t& r, uint8_t& g, uint8_t& b, uint8_t& a ) const;
 
 private:
     uint32_t hex_value;
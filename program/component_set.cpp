@@ -0,0 +1,8 @@
+#include "component_set.h"
+
+#include <atomic>
+
+size_t next_component_type() {
+    static std::atomic<size_t> count( 0 );
+    return count++;
+}
@@ -0,0 +1,113 @@
+#ifndef COMPONENT_SET_H
+#define COMPONENT_SET_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "entity.h"
+
+// marks an entity slot with no component in a set's index map
+#define NO_COMPONENT 0xFFFFFFFF
+
+// what the entity engine needs from every set, whatever it holds
+class ComponentSetBase {
+public:
+    virtual ~ComponentSetBase() {}
+    virtual void remove( const Entity id ) = 0;
+};
+
+// one component type for every entity that has it, as a sparse set. the
+// components are packed together in one array with the entity owning each
+// alongside, so a system walks straight through memory. the index map turns
+// an entity's slot into where its component sits in the packed array.
+// removing one moves the last component into the gap, so pointers and
+// positions are only good until the next add or remove
+template <typename T>
+class ComponentSet : public ComponentSetBase {
+public:
+    // replaces the component if the entity already has one
+    T* add( const Entity id, const T& component ) {
+        const uint32_t index = entity_index( id );
+        if ( index >= sparse.size() ) sparse.resize( index + 1, NO_COMPONENT );
+
+        if ( sparse[ index ] != NO_COMPONENT ) {
+            owners[ sparse[ index ] ] = id;
+            dense[ sparse[ index ] ] = component;
+            return &dense[ sparse[ index ] ];
+        }
+
+        sparse[ index ] = dense.size();
+        owners.push_back( id );
+        dense.push_back( component );
+        return &dense.back();
+    }
+
+    void remove( const Entity id ) override {
+        if ( !contains( id ) ) return;
+
+        const uint32_t position = sparse[ entity_index( id ) ];
+        dense[ position ] = dense.back();
+        owners[ position ] = owners.back();
+        sparse[ entity_index( owners[ position ] ) ] = position;
+        sparse[ entity_index( id ) ] = NO_COMPONENT;
+
+        dense.pop_back();
+        owners.pop_back();
+    }
+
+    // false for a stale handle, even if its slot has been reused since
+    inline bool contains( const Entity id ) const {
+        const uint32_t index = entity_index( id );
+        return index < sparse.size() && sparse[ index ] != NO_COMPONENT && owners[ sparse[ index ] ] == id;
+    }
+
+    // null if the entity doesn't have one
+    inline T* get( const Entity id ) {
+        return contains( id ) ? &dense[ sparse[ entity_index( id ) ] ] : nullptr;
+    }
+
+    // where the entity's component is in the packed array, NO_COMPONENT if
+    // it doesn't have one
+    inline uint32_t get_position( const Entity id ) const {
+        return contains( id ) ? sparse[ entity_index( id ) ] : NO_COMPONENT;
+    }
+
+    inline size_t size() const {
+        return dense.size();
+    }
+
+    // the packed components, and which entity owns each
+    inline T* data() {
+        return dense.data();
+    }
+
+    inline const Entity* get_entities() const {
+        return owners.data();
+    }
+
+    inline T& operator[]( const size_t position ) {
+        return dense[ position ];
+    }
+
+    inline Entity get_entity( const size_t position ) const {
+        return owners[ position ];
+    }
+
+private:
+    std::vector<T> dense;
+    std::vector<Entity> owners;
+    std::vector<uint32_t> sparse; // by entity slot
+};
+
+// a small number for each component type, handed out the first time the
+// type is used, for the entity engine to find its set with
+size_t next_component_type();
+
+template <typename T>
+size_t component_type() {
+    static const size_t type = next_component_type();
+    return type;
+}
+
+#endif
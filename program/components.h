@@ -17,4 +17,14 @@ struct DistanceComponent {
     float distance;
 };
 
+// the moving light that follows an enemy about
+struct GlowComponent {
+    int light;
+};
+
+// whether the enemy could see the player the last time it checked
+struct SightComponent {
+    bool can_see;
+};
+
 #endif
@@ -0,0 +1,75 @@
+#include "depth_order.h"
+
+#include <algorithm>
+
+#define RADIX_BITS 11
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+
+DepthOrder::DepthOrder() : radix_sort_count( 0 ) {}
+
+void DepthOrder::add( const uint32_t item ) {
+    entries.push_back( DepthEntry { 0, item } );
+}
+
+void DepthOrder::remove( const uint32_t item ) {
+    entries.erase( std::remove_if( entries.begin(), entries.end(),
+        [item]( const DepthEntry& e ) { return e.item == item; } ), entries.end() );
+}
+
+std::vector<DepthEntry>& DepthOrder::get_entries() {
+    return entries;
+}
+
+void DepthOrder::sort() {
+    // a few moves per entry is still well under what the radix sort costs
+    if ( !insertion_sort( entries.size() * 4 + 64 ) ) {
+        radix_sort();
+        radix_sort_count++;
+    }
+}
+
+size_t DepthOrder::get_radix_sort_count() const {
+    return radix_sort_count;
+}
+
+// returns false if it ran out of moves, leaving everything still in the
+// entries but only partly sorted
+bool DepthOrder::insertion_sort( const size_t move_budget ) {
+    size_t moves = 0;
+
+    for ( size_t i = 1; i < entries.size(); i++ ) {
+        const DepthEntry entry = entries[ i ];
+        size_t j = i;
+        while ( j > 0 && entries[ j - 1 ].key > entry.key ) {
+            entries[ j ] = entries[ j - 1 ];
+            j--;
+        }
+        entries[ j ] = entry;
+
+        moves += i - j;
+        if ( moves > move_budget ) return false;
+    }
+
+    return true;
+}
+
+// lsd radix sort over the 32 bit keys, 11 bits a pass. stable, so equal
+// depths keep the order they had
+void DepthOrder::radix_sort() {
+    scratch.resize( entries.size() );
+
+    for ( int shift = 0; shift < 32; shift += RADIX_BITS ) {
+        size_t counts[ RADIX_BUCKETS ] = {};
+        for ( auto& e : entries ) counts[ (e.key >> shift) & (RADIX_BUCKETS - 1) ]++;
+
+        size_t total = 0;
+        for ( auto& c : counts ) {
+            const size_t count = c;
+            c = total;
+            total += count;
+        }
+
+        for ( auto& e : entries ) scratch[ counts[ (e.key >> shift) & (RADIX_BUCKETS - 1) ]++ ] = e;
+        entries.swap( scratch );
+    }
+}
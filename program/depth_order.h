@@ -0,0 +1,51 @@
+#ifndef DEPTH_ORDER_H
+#define DEPTH_ORDER_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// the sort key sits next to the item so sorting never chases pointers
+struct DepthEntry {
+    uint32_t key;
+    uint32_t item;
+};
+
+// far to near drawing order that carries over from frame to frame. depths
+// barely move between frames, so last frame's order is nearly sorted already
+// and an insertion sort over it is close to linear. when too much has changed
+// (a teleport, a sharp turn, lots of new items) it gives up and radix sorts
+class DepthOrder {
+public:
+    DepthOrder();
+
+    void add( const uint32_t item );
+    void remove( const uint32_t item );
+
+    // in drawing order as of the last sort. keys get updated in place
+    std::vector<DepthEntry>& get_entries();
+    void sort();
+
+    // how many sorts had to fall back to the radix sort
+    size_t get_radix_sort_count() const;
+
+    // sorts ascending into far to near
+    static inline uint32_t make_key( const float distance ) {
+        // the bits of a non negative float order the same way it does
+        const float clamped = distance > 0 ? distance : 0.0f;
+        uint32_t bits;
+        std::memcpy( &bits, &clamped, sizeof( bits ) );
+        return ~bits;
+    }
+
+private:
+    bool insertion_sort( const size_t move_budget );
+    void radix_sort();
+
+    std::vector<DepthEntry> entries;
+    std::vector<DepthEntry> scratch;
+    size_t radix_sort_count;
+};
+
+#endif
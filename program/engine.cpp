@@ -1,7 +1,18 @@
 #include "engine.h"
 
 Engine::Engine( const std::string map_path, const std::string wall_tex_path, const std::string enemy_tex_path )
-    : wall_textures( wall_tex_path ), enemy_textures( enemy_tex_path ) {
+    : wall_textures( wall_tex_path ), enemy_textures( enemy_tex_path ),
+      wall_kernel( pick_wall_column_kernel<WINDOW_HEIGHT>( wall_textures.get_size() ) ),
+      sprite_kernel( pick_sprite_column_kernel( enemy_textures.get_size() ) ),
+      sprite_blend_kernel( pick_sprite_blend_kernel( enemy_textures.get_size() ) ),
+      floor_kernel( pick_floor_row_kernel( wall_textures.get_size() ) ),
+      indexed_wall_kernel( pick_wall_column_kernel<WINDOW_HEIGHT, uint8_t, ColorMap>( wall_textures.get_size() ) ),
+      indexed_sprite_kernel( pick_sprite_column_kernel<uint8_t, ColorMap>( enemy_textures.get_size() ) ),
+      indexed_floor_kernel( pick_floor_row_kernel<uint8_t, ColorMap>( wall_textures.get_size() ) ),
+      workers( std::max( 1u, std::thread::hardware_concurrency() ) - 1 ), palette_mode( false ),
+      floor_texture( Wall1 ), ceiling_texture( Wall2 ), fog_enabled( false ), lighting_enabled( false ),
+      previous_hits_valid( false ), interlace_phase( 0 ),
+      minimap_interval( 1 ), minimap_phase( 0 ), minimap_drawn( false ), minimap_stale( false ) {
     // read in map
     std::fstream f;
     f.open( map_path, std::ios::in );
@@ -11,7 +22,7 @@ Engine::Engine( const std::string map_path, const std::string wall_tex_path, con
     map_width = std::stoi( width_str );
     map_height = std::stoi( height_str );
     char tile;
-    while ( f >> std::noskipws >> tile ) {
+    while ( map.size() < map_width * map_height && f >> std::noskipws >> tile ) {
         switch ( tile ) {
             case '\n': // ignore
                 break;
@@ -39,8 +50,52 @@ Engine::Engine( const std::string map_path, const std::string wall_tex_path, con
         }
     }
 
+    // anything after the tiles is extra map data, one entry per line
+    std::string line;
+    while ( std::getline( f, line ) ) {
+        std::istringstream entry( line );
+        std::string kind;
+        entry >> kind;
+
+        if ( kind == "light" ) {
+            Light light;
+            entry >> light.x >> light.y >> light.radius >> light.intensity;
+            if ( entry ) static_lights.push_back( light );
+            else std::cerr << "bad light entry: " << line << std::endl;
+        } else if ( !kind.empty() ) {
+            std::cerr << "unrecognised map entry: " << kind << std::endl;
+        }
+    }
+
     f.close();
 
+    for ( size_t i = 0; i < light_scales.size(); i++ ) {
+        light_scales[ i ] = (i * 256 + 127) / 255;
+    }
+
+    if ( !static_lights.empty() ) {
+        bake_lightmap();
+        lighting_enabled = true;
+    }
+
+    light_grid.resize( map_width, map_height );
+    visible_cells.resize( map_width, map_height );
+    sprites_front_to_back = false;
+    sprite_coverage.resize( (WINDOW_WIDTH / 2) * COVERAGE_WORDS );
+    sprite_cache_enabled = false;
+    sprite_blending = false;
+    particles_drawn = false;
+    last_particles_drawn = false;
+    shared_visible_cells.resize( map_width, map_height );
+    update_count = 0;
+
+    // the flat colours the passes draw with get entries of their own
+    wall_textures.add_to_palette( palette );
+    enemy_textures.add_to_palette( palette );
+    palette.build( { Color( 0xBBBBBBFF ), Color( 0x5555DDFF ), Color( 0xFF0000FF ), Color( 0x00FFFFFF ) } );
+    wall_textures.build_indices( palette );
+    enemy_textures.build_indices( palette );
+
     player = Player {
         Vec2 { 2.0, 7.0 },
         1.0,
@@ -51,6 +106,22 @@ Engine::Engine( const std::string map_path, const std::string wall_tex_path, con
     add_enemy( 2.5, 9.0, 0.5, EnemyType::FlushedHaw );
     add_enemy( 5.0, 10.0, 0.5, EnemyType::YeeHaw );
     add_enemy( 5.5, 9.0, 0.5, EnemyType::YeeHaw );
+
+    render_passes = {
+        &Engine::cast_pass,
+        &Engine::shade_pass,
+        &Engine::floor_pass,
+        &Engine::minimap_pass,
+        &Engine::sprite_pass,
+        &Engine::particle_pass
+    };
+    pass_times.fill( 0.0f );
+    column_rates.fill( 1 );
+
+    // nothing has been presented yet, so the first frame goes up whole
+    mark_dirty( Rect { 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT } );
+    last_camera_position = player.position;
+    last_camera_angle = player.view_angle;
 }
 
 void Engine::update( const float delta_time ) {
@@ -91,15 +162,255 @@ void Engine::update( const float delta_time ) {
 
     player_move_dir_lock.unlock();
     player_view_lock.unlock();
+
+    particles_lock.lock();
+    particles.update( delta_time );
+    particles_lock.unlock();
 }
 
 void Engine::render() {
+    player_view_lock.lock();
+    camera = player;
+    player_view_lock.unlock();
+
     framebuffer_lock.lock();
-    clear_framebuffer( Color( 0xBBBBBBFF ) );
+
+    update_dynamic_lights();
+
+    for ( size_t i = 0; i < render_passes.size(); i++ ) {
+        const auto start = std::chrono::steady_clock::now();
+        (this->*render_passes[ i ])();
+        const auto end = std::chrono::steady_clock::now();
+        pass_times[ i ] = std::chrono::duration<float, std::milli>( end - start ).count();
+    }
+
+    update_dirty_rects();
+
+    visible_cells_lock.lock();
+    shared_visible_cells = visible_cells;
+    visible_cells_lock.unlock();
+
+    framebuffer_lock.unlock();
+}
+
+// march a ray for every column of the 3d view and record what it hit
+void Engine::cast_pass() {
+    const float column_step = camera.fov / (WINDOW_WIDTH / 2);
+    visible_cells.clear();
+
+    // with a lower shading rate only the first column of each group needs a
+    // ray, aimed through the middle of the group
+    for ( int i = 0; i < WINDOW_WIDTH / 2; i += column_rates[ i ] ) {
+        cast_column( i, get_column_angle( i ) + column_step * (column_rates[ i ] - 1) / 2 );
+    }
+}
+
+// like cast_pass, but each column is snapped to the nearest cache bucket angle
+// (never more than half a column off) and only buckets that haven't been
+// traced from this position yet get a new ray
+void Engine::cached_cast_pass() {
+    if ( hit_cache.filled.empty() || hit_cache.origin != camera.position || hit_cache.fov != camera.fov ) {
+        reset_hit_cache();
+    }
+
+    const long bucket_count = hit_cache.filled.size();
+    for ( int i = 0; i < WINDOW_WIDTH / 2; i++ ) {
+        const float angle = get_column_angle( i );
+        const long steps = std::lround( angle / hit_cache.bucket_size );
+        const long bucket = ((steps % bucket_count) + bucket_count) % bucket_count;
+        const float bucket_angle = steps * hit_cache.bucket_size;
+
+        if ( !hit_cache.filled[ bucket ] ) {
+            cast_column( i, bucket_angle );
+
+            hit_cache.filled[ bucket ] = 1;
+            hit_cache.ray_length[ bucket ] = column_hits.ray_length[ i ];
+            hit_cache.tile[ bucket ] = column_hits.tile[ i ];
+            hit_cache.cell[ bucket ] = column_hits.cell[ i ];
+            hit_cache.face[ bucket ] = column_hits.face[ i ];
+            hit_cache.texcoord[ bucket ] = column_hits.texcoord[ i ];
+            hit_cache.hit_x[ bucket ] = column_hits.hit_x[ i ];
+            hit_cache.hit_y[ bucket ] = column_hits.hit_y[ i ];
+            continue;
+        }
+
+        column_hits.distance[ i ] = hit_cache.ray_length[ bucket ] * std::cos( bucket_angle - camera.view_angle );
+        column_hits.ray_length[ i ] = hit_cache.ray_length[ bucket ];
+        column_hits.tile[ i ] = hit_cache.tile[ bucket ];
+        column_hits.cell[ i ] = hit_cache.cell[ bucket ];
+        column_hits.face[ i ] = hit_cache.face[ bucket ];
+        column_hits.texcoord[ i ] = hit_cache.texcoord[ bucket ];
+        column_hits.hit_x[ i ] = hit_cache.hit_x[ bucket ];
+        column_hits.hit_y[ i ] = hit_cache.hit_y[ bucket ];
+    }
+}
+
+// adjacent columns mostly land on the same wall face, so only march rays at the
+// edges of fixed width spans and split a span in half whenever its two ends
+// disagree. columns between two ends on the same face get intersected with that
+// face directly instead of being marched
+void Engine::span_cast_pass() {
+    const int last_column = WINDOW_WIDTH / 2 - 1;
+    visible_cells.clear();
+
+    cast_column( 0, get_column_angle( 0 ) );
+    for ( int first = 0; first < last_column; first += WALL_SPAN_WIDTH ) {
+        const int last = std::min( first + WALL_SPAN_WIDTH, last_column );
+        cast_column( last, get_column_angle( last ) );
+        cast_span( first, last );
+    }
+}
+
+// casts every other column each frame, alternating which half. the rest take
+// the wall face the same ray angle hit last frame and get re-intersected with
+// it from the new camera. that's only trusted if the face still contains the
+// hit and a freshly cast neighbour agrees on it, otherwise the column gets cast
+// too. big camera jumps recast everything
+void Engine::interlaced_cast_pass() {
+    const float column_step = camera.fov / (WINDOW_WIDTH / 2);
+    const float turn = camera.view_angle - previous_camera.view_angle;
+    auto moved = camera.position - previous_camera.position;
+
+    const bool refresh_all = !previous_hits_valid
+        || previous_camera.fov != camera.fov
+        || moved.magnitude() > INTERLACE_MAX_MOVE
+        || std::abs( turn ) > INTERLACE_MAX_TURN_COLUMNS * column_step;
+
+    // standing still, last frame's hits are this frame's. casting half of
+    // them again would only flicker between two slightly different frames,
+    // and the visible cells haven't changed either
+    if ( previous_hits_valid && turn == 0 && moved == Vec2 { 0, 0 } && previous_camera.fov == camera.fov ) {
+        column_hits = previous_hits;
+        return;
+    }
+
+    // the reused columns sit between freshly cast ones, so the cast columns
+    // alone still cover the cells in view
+    visible_cells.clear();
+
+    if ( refresh_all ) {
+        cast_pass();
+    } else {
+        for ( int i = interlace_phase; i < WINDOW_WIDTH / 2; i += 2 ) {
+            cast_column( i, get_column_angle( i ) );
+        }
+
+        for ( int i = 1 - interlace_phase; i < WINDOW_WIDTH / 2; i += 2 ) {
+            const int source = i + std::lround( turn / column_step );
+            const bool in_view = source >= 0 && source < WINDOW_WIDTH / 2;
+
+            if ( !in_view || previous_hits.tile[ source ] == Floor ) {
+                cast_column( i, get_column_angle( i ) );
+                continue;
+            }
+
+            const int cell = previous_hits.cell[ source ];
+            const auto face = previous_hits.face[ source ];
+            const bool left_agrees = i > 0
+                && column_hits.cell[ i - 1 ] == cell && column_hits.face[ i - 1 ] == face;
+            const bool right_agrees = i < WINDOW_WIDTH / 2 - 1
+                && column_hits.cell[ i + 1 ] == cell && column_hits.face[ i + 1 ] == face;
+
+            const bool confident = (left_agrees || right_agrees)
+                && intersect_face( i, previous_hits.tile[ source ], cell, face );
+            if ( !confident ) cast_column( i, get_column_angle( i ) );
+        }
+    }
+
+    interlace_phase = 1 - interlace_phase;
+    previous_hits = column_hits;
+    previous_camera = camera;
+    previous_hits_valid = true;
+}
+
+// draw every wall column (and the flat colour above and below it) from the
+// cast pass' hits, once per shading rate group
+void Engine::shade_pass() {
+    for ( int i = 0; i < WINDOW_WIDTH / 2; i += column_rates[ i ] ) {
+        draw_wall_column( i, column_rates[ i ] );
+
+        // the rest of the group shows this column's wall, so the sprites and
+        // minimap need to see the same hit
+        for ( int j = i + 1; j < i + column_rates[ i ]; j++ ) copy_column_hit( i, j );
+    }
+}
+
+// textured floor and ceiling, cast a row at a time. every row of floor sits at
+// one distance from the camera, and its ceiling mirror at the same distance, so
+// the per-row setup is just a couple of multiplies. rows are independent so
+// they get shared out across the worker pool
+void Engine::floor_pass() {
+    if ( floor_texture < 0 || ceiling_texture < 0 ) return;
+
+    for ( int i = 0; i < WINDOW_WIDTH / 2; i++ ) {
+        column_tans[ i ] = std::tan( get_column_angle( i ) - camera.view_angle );
+
+        // same bounds the wall kernel used, so nothing gets left unfilled
+        if ( column_hits.tile[ i ] == Floor ) {
+            ceiling_end[ i ] = WINDOW_HEIGHT / 2;
+            floor_start[ i ] = WINDOW_HEIGHT / 2;
+            continue;
+        }
+
+        const int column_height = WINDOW_HEIGHT / std::max( column_hits.distance[ i ], .01f );
+        const int top = WINDOW_HEIGHT / 2 - column_height / 2;
+        const int start = std::max( 0, top );
+        ceiling_end[ i ] = start;
+        floor_start[ i ] = std::max( start, std::min( WINDOW_HEIGHT, top + column_height ) );
+    }
+
+    const float forward_x = std::cos( camera.view_angle );
+    const float forward_y = std::sin( camera.view_angle );
+    const float right_x = -forward_y;
+    const float right_y = forward_x;
+    const auto floor_texels = wall_textures.get_column_data( floor_texture, 0 );
+    const auto ceiling_texels = wall_textures.get_column_data( ceiling_texture, 0 );
+    const auto floor_indices = wall_textures.get_column_indices( floor_texture, 0 );
+    const auto ceiling_indices = wall_textures.get_column_indices( ceiling_texture, 0 );
+    const size_t tex_size = wall_textures.get_size();
+
+    workers.parallel_for( WINDOW_HEIGHT / 2, [&]( const size_t begin, const size_t end ) {
+        uint32_t offsets[ WINDOW_WIDTH / 2 ];
+
+        for ( size_t row = begin; row < end; row++ ) {
+            const int floor_y = WINDOW_HEIGHT / 2 + row;
+            const int ceiling_y = WINDOW_HEIGHT / 2 - 1 - row;
+            const float row_dist = WINDOW_HEIGHT / (2 * (row + .5f));
+
+            if ( palette_mode ) {
+                indexed_floor_kernel( &index_framebuffer[ WINDOW_WIDTH / 2 + floor_y * WINDOW_WIDTH ],
+                    &index_framebuffer[ WINDOW_WIDTH / 2 + ceiling_y * WINDOW_WIDTH ], WINDOW_WIDTH / 2,
+                    camera.position.x + forward_x * row_dist, camera.position.y + forward_y * row_dist,
+                    right_x * row_dist, right_y * row_dist,
+                    column_tans.data(), floor_start.data(), ceiling_end.data(), floor_y, ceiling_y,
+                    floor_indices, ceiling_indices, tex_size, get_color_map( row_dist, 255 ), offsets );
+                continue;
+            }
+
+            floor_kernel( &framebuffer[ WINDOW_WIDTH / 2 + floor_y * WINDOW_WIDTH ],
+                &framebuffer[ WINDOW_WIDTH / 2 + ceiling_y * WINDOW_WIDTH ], WINDOW_WIDTH / 2,
+                camera.position.x + forward_x * row_dist, camera.position.y + forward_y * row_dist,
+                right_x * row_dist, right_y * row_dist,
+                column_tans.data(), floor_start.data(), ceiling_end.data(), floor_y, ceiling_y,
+                floor_texels, ceiling_texels, tex_size, get_fog_level( row_dist ), offsets );
+        }
+    } );
+}
+
+void Engine::minimap_pass() {
+    // anything already marked over the minimap, like a settings change, needs
+    // it drawn now rather than at the next turn
+    const Rect minimap_area { 0, 0, WINDOW_WIDTH / 2, WINDOW_HEIGHT };
+    minimap_phase = (minimap_phase + 1) % minimap_interval;
+    minimap_drawn = minimap_phase == 0 || std::any_of( dirty_rects.begin(), dirty_rects.end(),
+        [&]( const Rect& r ) { return !r.clipped( minimap_area ).empty(); } );
+    if ( !minimap_drawn ) return;
 
     const size_t rect_w = WINDOW_WIDTH / (map_width * 2);
     const size_t rect_h = WINDOW_HEIGHT / map_height;
 
+    draw_rect( 0, 0, WINDOW_WIDTH / 2, WINDOW_HEIGHT, Color( 0xBBBBBBFF ) );
+
     // draw map
     for ( int y = 0; y < map_height; y++ ) {
         for ( int x = 0; x < map_width; x++ ) {
@@ -128,66 +439,130 @@ void Engine::render() {
         }
     }
 
-    // draw view cone and 3d view
-    for ( int i = 0; i < WINDOW_WIDTH / 2; i++ ) {
-        const float angle = player.view_angle - player.fov / 2 + player.fov * i / float(WINDOW_WIDTH / 2);
-        for ( float ray_dist = 0; ray_dist < 20; ray_dist += .01 ) {
-            const float cx = player.position.x + ray_dist * cos( angle );
-            const float cy = player.position.y + ray_dist * sin( angle );
-
-            // view cone
-            draw_pixel( cx * rect_w, cy * rect_h, Color( 0x5555DDFF ) );
-
-            // the 3d magic!
-            const auto tile = get_map_tile( int(cx), int(cy) );
-            if ( tile == Floor ) continue; // skip empty space
-
-            const float dist = ray_dist * cos( angle - player.view_angle );
-            depth_buffer[ i ] = dist;
-            const int column_height = WINDOW_HEIGHT / dist;
-
-            // wall texturing
-            const float hit_x = cx - floor( cx + .5 );
-            const float hit_y = cy - floor( cy + .5 );
-            int x_texcoord = hit_x * wall_textures.get_size();
-            if ( std::abs( hit_y ) > std::abs( hit_x ) ) { // check if vertical or horizontal wall
-                x_texcoord = hit_y * wall_textures.get_size();
-            }
+    draw_view_cone( rect_w, rect_h );
 
-            if ( x_texcoord < 0 ) x_texcoord += wall_textures.get_size();
+    auto& movement = enemy_manager.get_components<MovementComponent>();
+    for ( size_t i = 0; i < movement.size(); i++ ) {
+        draw_rect( movement[ i ].x * rect_w, movement[ i ].y * rect_h, 5, 5, Color( 0xFF0000FF ) );
+    }
+}
 
-            const auto column = wall_textures.get_column( column_height, tile, x_texcoord );
-            const int pixel_x = i + WINDOW_WIDTH / 2;
-            for ( size_t j = 0; j < column_height; j++ ) {
-                const int pixel_y = j + WINDOW_HEIGHT / 2 - column_height / 2;
-                if ( pixel_y < 0 || pixel_y >= WINDOW_HEIGHT ) continue;
-                draw_pixel( pixel_x, pixel_y, column[ j ] );
-            }
+void Engine::sprite_pass() {
+    project_sprites();
 
-            break;
+    // enemies that have gone since last frame drop out of the order
+    auto& movement = enemy_manager.get_components<MovementComponent>();
+    auto& entries = sprite_order.get_entries();
+    for ( size_t n = entries.size(); n-- > 0; ) {
+        if ( movement.get_position( entries[ n ].item ) == NO_COMPONENT ) sprite_order.remove( entries[ n ].item );
+    }
+
+    // the entries are still in last frame's order, so once the keys are
+    // refreshed this is mostly already sorted
+    for ( auto& entry : entries ) {
+        entry.key = DepthOrder::make_key( sprite_batch.distance[ movement.get_position( entry.item ) ] );
+    }
+    sprite_order.sort();
+
+    depth_tree.build( column_hits.distance.data(), WINDOW_WIDTH / 2 );
+
+    sprite_bounds.clear();
+    // anything see-through has to go over whatever's behind it
+    const bool blended = sprite_blending && !palette_mode;
+    const bool front_to_back = sprites_front_to_back && !blended;
+    if ( front_to_back ) std::fill( sprite_coverage.begin(), sprite_coverage.end(), 0 );
+
+    // front to back just walks the same order from the other end, and every
+    // pixel ends up drawn once by whichever sprite is nearest
+    sprite_draws.clear();
+    for ( size_t n = 0; n < entries.size(); n++ ) {
+        const size_t i = movement.get_position( entries[ front_to_back ? entries.size() - 1 - n : n ].item );
+        if ( sprite_batch.depth[ i ] <= 0 ) continue; // behind the camera
+
+        // nothing near an enemy was in view, so there's no way any of it shows
+        if ( !visible_cells.contains_near( sprite_batch.world_x[ i ], sprite_batch.world_y[ i ] ) ) continue;
+
+        sprite_draws.emplace_back();
+        sprite_draws.back().blended = blended;
+        if ( !prepare_sprite( i, sprite_draws.back() ) ) sprite_draws.pop_back();
+    }
+
+    // each tile gets the sprites that overlap it, still in drawing order, so
+    // every column sees the same sprites in the same order it would have
+    // drawn in one thread
+    for ( auto& tile : sprite_tiles ) tile.clear();
+    for ( size_t d = 0; d < sprite_draws.size(); d++ ) {
+        const int last_tile = (sprite_draws[ d ].end - 1) / SPRITE_TILE_WIDTH;
+        for ( int t = sprite_draws[ d ].begin / SPRITE_TILE_WIDTH; t <= last_tile; t++ ) sprite_tiles[ t ].push_back( d );
+    }
+
+    workers.parallel_for( SPRITE_TILE_COUNT, [&]( const size_t begin, const size_t end ) {
+        for ( size_t t = begin; t < end; t++ ) {
+            const int first_column = t * SPRITE_TILE_WIDTH;
+            const int last_column = std::min( first_column + SPRITE_TILE_WIDTH, WINDOW_WIDTH / 2 );
+            for ( auto d : sprite_tiles[ t ] ) draw_sprite( sprite_draws[ d ], first_column, last_column );
         }
+    } );
+
+    if ( sprite_cache_enabled ) sprite_cache.trim();
+}
+
+// particles go over the sprites, only tested against the walls
+void Engine::particle_pass() {
+    const ParticleView view {
+        camera.position.x, camera.position.y, std::cos( camera.view_angle ), std::sin( camera.view_angle ),
+        (WINDOW_WIDTH / 2) / camera.fov, get_sprite_centre_column(), WINDOW_WIDTH / 2, WINDOW_HEIGHT
+    };
+
+    particles_lock.lock();
+    particle_batch.build( particles, view, fog_enabled ? &fog_table : nullptr, palette_mode ? &palette : nullptr, workers );
+    particles_lock.unlock();
+
+    if ( palette_mode ) {
+        particle_batch.draw( &index_framebuffer[ WINDOW_WIDTH / 2 ], WINDOW_WIDTH, column_hits.distance.data(), workers );
+    } else {
+        particle_batch.draw( &framebuffer[ WINDOW_WIDTH / 2 ], WINDOW_WIDTH, column_hits.distance.data(), workers );
     }
 
-    // draw the enemies
-    std::sort( active_enemies.begin(), active_enemies.end(),
-        [this]( Entity a, Entity b ) {
-            const auto a_dist = enemy_manager.get_distance_component( a );
-            const auto b_dist = enemy_manager.get_distance_component( b );
-            return a_dist->distance > b_dist->distance;
-        } );
+    particles_drawn = particle_batch.get_drawn_count() > 0;
+    if ( particles_drawn ) {
+        Rect bounds = particle_batch.get_bounds();
+        bounds.x += WINDOW_WIDTH / 2;
+        sprite_bounds.push_back( bounds );
+    }
+}
 
-    for ( auto& e : active_enemies ) {
-        const auto move_comp = enemy_manager.get_movement_component( e );
-        draw_rect( move_comp->x * rect_w, move_comp->y * rect_h, 5, 5, Color( 0xFF0000FF ) );
-        draw_sprite( e );
+// gathers every enemy's position and puts the whole lot through the camera
+// transform in one straight loop, rather than an atan2 per sprite
+void Engine::project_sprites() {
+    auto& movement = enemy_manager.get_components<MovementComponent>();
+    const size_t count = movement.size();
+    sprite_batch.world_x.resize( count );
+    sprite_batch.world_y.resize( count );
+    sprite_batch.depth.resize( count );
+    sprite_batch.distance.resize( count );
+    sprite_batch.screen_x.resize( count );
+
+    for ( size_t i = 0; i < count; i++ ) {
+        sprite_batch.world_x[ i ] = movement[ i ].x;
+        sprite_batch.world_y[ i ] = movement[ i ].y;
     }
 
-    framebuffer_lock.unlock();
+    project_sprite_batch( count, sprite_batch.world_x.data(), sprite_batch.world_y.data(),
+        camera.position.x, camera.position.y, std::cos( camera.view_angle ), std::sin( camera.view_angle ),
+        (WINDOW_WIDTH / 2) / camera.fov, get_sprite_centre_column(),
+        sprite_batch.depth.data(), sprite_batch.distance.data(), sprite_batch.screen_x.data() );
 }
 
 void Engine::get_framebuffer( uint8_t* target ) {
     framebuffer_lock.lock();
 
+    if ( palette_mode ) {
+        for ( int i = 0; i < FRAMEBUFFER_LENGTH; i++ ) palette.expand( index_framebuffer[ i ], &target[ i * 4 ] );
+        framebuffer_lock.unlock();
+        return;
+    }
+
     for ( int i = 0; i < FRAMEBUFFER_LENGTH; i++ ) {
         uint8_t r, g, b, a;
         framebuffer[ i ].get_components( r, g, b, a );
@@ -200,6 +575,40 @@ void Engine::get_framebuffer( uint8_t* target ) {
     framebuffer_lock.unlock();
 }
 
+// copies only the regions that changed since the last call into target, each
+// one packed tightly after the previous so they can be uploaded one at a time
+void Engine::get_dirty_framebuffer( uint8_t* target, std::vector<Rect>& regions ) {
+    framebuffer_lock.lock();
+
+    regions = dirty_rects;
+    dirty_rects.clear();
+
+    size_t offset = 0;
+    for ( auto& r : regions ) {
+        if ( palette_mode ) {
+            for ( int y = r.y; y < r.y + r.h; y++ ) {
+                const uint8_t* row = &index_framebuffer[ y * WINDOW_WIDTH ];
+                for ( int x = r.x; x < r.x + r.w; x++, offset += 4 ) palette.expand( row[ x ], &target[ offset ] );
+            }
+            continue;
+        }
+
+        for ( int y = r.y; y < r.y + r.h; y++ ) {
+            for ( int x = r.x; x < r.x + r.w; x++ ) {
+                uint8_t red, g, b, a;
+                framebuffer[ x + y * WINDOW_WIDTH ].get_components( red, g, b, a );
+                target[ offset ] = red;
+                target[ offset + 1 ] = g;
+                target[ offset + 2 ] = b;
+                target[ offset + 3 ] = a;
+                offset += 4;
+            }
+        }
+    }
+
+    framebuffer_lock.unlock();
+}
+
 void Engine::move_view( const float delta ) {
     player_view_lock.lock();
     player.view_angle += delta;
@@ -212,11 +621,449 @@ void Engine::set_player_move_dir( const Vec2 dir ) {
     player_move_dir_lock.unlock();
 }
 
-void Engine::clear_framebuffer( const Color color ) {
-    draw_rect( 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, color );
+// 1 draws the minimap every frame, more leaves the last one up in between
+void Engine::set_minimap_interval( const int frames ) {
+    framebuffer_lock.lock();
+    minimap_interval = std::max( 1, frames );
+    minimap_phase = 0;
+    framebuffer_lock.unlock();
+}
+
+void Engine::set_cast_mode( const CastMode mode ) {
+    framebuffer_lock.lock();
+
+    switch ( mode ) {
+        case CastCached:
+            render_passes[ CastPass ] = &Engine::cached_cast_pass;
+            break;
+
+        case CastSpans:
+            render_passes[ CastPass ] = &Engine::span_cast_pass;
+            break;
+
+        case CastInterlaced:
+            render_passes[ CastPass ] = &Engine::interlaced_cast_pass;
+            previous_hits_valid = false;
+            break;
+
+        default:
+            render_passes[ CastPass ] = &Engine::cast_pass;
+            break;
+    }
+
+    // the modes don't all come out pixel for pixel the same, and the
+    // minimap's view cone follows the hits
+    mark_dirty( Rect { 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT } );
+    framebuffer_lock.unlock();
+}
+
+// full density inside the middle centre_fraction of the view, then the number
+// of columns sharing one ray and one shading step ramps up to edge_rate at the
+// edges of the screen
+void Engine::set_shading_rates( const float centre_fraction, const int edge_rate ) {
+    const int view_width = WINDOW_WIDTH / 2;
+    const int max_rate = std::max( 1, std::min( edge_rate, 255 ) );
+    const int centre_width = std::max( 0.0f, std::min( 1.0f, centre_fraction ) ) * view_width;
+    const int centre_start = (view_width - centre_width) / 2;
+    const int centre_end = centre_start + centre_width;
+
+    framebuffer_lock.lock();
+
+    column_rates.fill( 0 );
+    int i = 0;
+    while ( i < view_width ) {
+        int rate = 1;
+        if ( i < centre_start ) {
+            rate = 1 + (max_rate - 1) * (centre_start - i) / std::max( 1, centre_start );
+            rate = std::min( rate, centre_start - i ); // don't spill into the centre
+        } else if ( i >= centre_end ) {
+            rate = 1 + (max_rate - 1) * (i - centre_end) / std::max( 1, view_width - centre_end );
+        }
+
+        rate = std::max( 1, std::min( rate, view_width - i ) );
+        column_rates[ i ] = rate;
+        i += rate;
+    }
+
+    // the minimap's view cone shows the hits shared across each group too
+    mark_dirty( Rect { 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT } );
+    framebuffer_lock.unlock();
+}
+
+void Engine::set_floor_textures( const int floor_index, const int ceiling_index ) {
+    framebuffer_lock.lock();
+    floor_texture = floor_index < int(wall_textures.get_count()) ? floor_index : -1;
+    ceiling_texture = ceiling_index < int(wall_textures.get_count()) ? ceiling_index : -1;
+    mark_dirty( Rect { WINDOW_WIDTH / 2, 0, WINDOW_WIDTH / 2, WINDOW_HEIGHT } );
+    framebuffer_lock.unlock();
+}
+
+void Engine::set_fog( const bool enabled, const Color color, const float density ) {
+    framebuffer_lock.lock();
+    fog_enabled = enabled;
+    if ( enabled ) fog_table.build( color, density );
+    palette.build_color_maps( enabled ? &fog_table : nullptr );
+    mark_dirty( Rect { WINDOW_WIDTH / 2, 0, WINDOW_WIDTH / 2, WINDOW_HEIGHT } );
+    framebuffer_lock.unlock();
+}
+
+void Engine::set_sprites_front_to_back( const bool enabled ) {
+    framebuffer_lock.lock();
+    sprites_front_to_back = enabled;
+    framebuffer_lock.unlock();
+}
+
+void Engine::set_sprite_cache_enabled( const bool enabled ) {
+    framebuffer_lock.lock();
+    sprite_cache_enabled = enabled;
+    if ( !enabled ) sprite_cache.clear();
+    // cached sprites are drawn at quantised sizes
+    mark_dirty( Rect { WINDOW_WIDTH / 2, 0, WINDOW_WIDTH / 2, WINDOW_HEIGHT } );
+    framebuffer_lock.unlock();
+}
+
+void Engine::set_sprite_blending( const bool enabled ) {
+    framebuffer_lock.lock();
+    sprite_blending = enabled;
+    mark_dirty( Rect { WINDOW_WIDTH / 2, 0, WINDOW_WIDTH / 2, WINDOW_HEIGHT } );
+    framebuffer_lock.unlock();
+}
+
+void Engine::set_palette_mode( const bool enabled ) {
+    framebuffer_lock.lock();
+    palette_mode = enabled;
+    mark_dirty( Rect { 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT } );
+    framebuffer_lock.unlock();
+}
+
+void Engine::set_lighting_enabled( const bool enabled ) {
+    framebuffer_lock.lock();
+    lighting_enabled = enabled && lightmap.is_baked();
+    mark_dirty( Rect { WINDOW_WIDTH / 2, 0, WINDOW_WIDTH / 2, WINDOW_HEIGHT } );
+    framebuffer_lock.unlock();
+}
+
+void Engine::emit_particles( const ParticleBurst& burst ) {
+    particles_lock.lock();
+    particles.emit( burst );
+    particles_lock.unlock();
+}
+
+Player Engine::get_player() {
+    player_view_lock.lock();
+    const Player copy = player;
+    player_view_lock.unlock();
+
+    return copy;
+}
+
+void Engine::set_map_tile( const int x, const int y, const MapTile tile ) {
+    framebuffer_lock.lock();
+    map[ x + y * map_width ] = tile;
+    if ( lightmap.is_baked() ) bake_lightmap();
+    // anything traced through the old map is stale
+    hit_cache.filled.clear();
+    previous_hits_valid = false;
+    // the minimap shows the tile, the view its walls and their light
+    mark_dirty( Rect { 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT } );
+    framebuffer_lock.unlock();
+}
+
+float Engine::get_pass_time_ms( const RenderPassId pass ) {
+    framebuffer_lock.lock();
+    const float time = pass_times[ pass ];
+    framebuffer_lock.unlock();
+
+    return time;
+}
+
+SpriteCacheStats Engine::get_sprite_cache_stats() {
+    framebuffer_lock.lock();
+    const auto stats = sprite_cache.get_stats();
+    framebuffer_lock.unlock();
+
+    return stats;
+}
+
+void Engine::cast_column( const int column, const float angle ) {
+    const float dir_x = std::cos( angle );
+    const float dir_y = std::sin( angle );
+
+    // if nothing gets hit the ray just stops at its max length
+    column_hits.distance[ column ] = 20;
+    column_hits.ray_length[ column ] = 20;
+    column_hits.tile[ column ] = Floor;
+    column_hits.cell[ column ] = -1;
+    column_hits.face[ column ] = FaceWest;
+    column_hits.texcoord[ column ] = 0;
+    column_hits.hit_x[ column ] = camera.position.x + 20 * dir_x;
+    column_hits.hit_y[ column ] = camera.position.y + 20 * dir_y;
+
+    int last_cell = -1;
+    int last_cell_x = int(camera.position.x);
+    int last_cell_y = int(camera.position.y);
+    for ( float ray_dist = 0; ray_dist < 20; ray_dist += .01 ) {
+        const float cx = camera.position.x + ray_dist * dir_x;
+        const float cy = camera.position.y + ray_dist * dir_y;
+        const int cell_x = int(cx);
+        const int cell_y = int(cy);
+
+        // note every cell the ray crosses, it only changes every so many steps
+        const int cell = cell_x + cell_y * map_width;
+        if ( cell != last_cell ) {
+            visible_cells.insert( cell );
+            last_cell = cell;
+        }
+
+        const auto tile = get_map_tile( cell_x, cell_y );
+        if ( tile == Floor ) {
+            // skip empty space
+            last_cell_x = cell_x;
+            last_cell_y = cell_y;
+            continue;
+        }
+
+        // the face hit is the side the ray came in through. guessing from the
+        // nearest grid line picks the buried face between two wall tiles when
+        // the ray lands right by the seam. a step that crosses both lines
+        // came in on whichever side has floor in front of it
+        const float hit_x = cx - floor( cx + .5 );
+        const float hit_y = cy - floor( cy + .5 );
+        bool vertical = cell_x != last_cell_x;
+        if ( cell_x != last_cell_x && cell_y != last_cell_y ) {
+            vertical = get_map_tile( last_cell_x, cell_y ) == Floor;
+        } else if ( cell_x == last_cell_x && cell_y == last_cell_y ) {
+            vertical = std::abs( hit_y ) > std::abs( hit_x ); // started inside a wall
+        }
+
+        int x_texcoord = hit_x * wall_textures.get_size();
+        if ( vertical ) {
+            x_texcoord = hit_y * wall_textures.get_size();
+        }
+
+        if ( x_texcoord < 0 ) x_texcoord += wall_textures.get_size();
+
+        WallFace face;
+        if ( vertical ) face = dir_x > 0 ? FaceWest : FaceEast;
+        else face = dir_y > 0 ? FaceNorth : FaceSouth;
+
+        column_hits.distance[ column ] = ray_dist * cos( angle - camera.view_angle );
+        column_hits.ray_length[ column ] = ray_dist;
+        column_hits.tile[ column ] = tile;
+        column_hits.cell[ column ] = int(cx) + int(cy) * map_width;
+        column_hits.face[ column ] = face;
+        column_hits.texcoord[ column ] = x_texcoord;
+        column_hits.hit_x[ column ] = cx;
+        column_hits.hit_y[ column ] = cy;
+        break;
+    }
+}
+
+// both ends of the span have already been cast
+void Engine::cast_span( const int first, const int last ) {
+    if ( last - first < 1 ) return;
+
+    const bool same_face = column_hits.tile[ first ] != Floor
+        && column_hits.cell[ first ] == column_hits.cell[ last ]
+        && column_hits.face[ first ] == column_hits.face[ last ];
+
+    if ( same_face ) {
+        // the ends get redone too so the whole span lines up exactly
+        const auto tile = column_hits.tile[ first ];
+        const auto cell = column_hits.cell[ first ];
+        const auto face = column_hits.face[ first ];
+        bool on_face = true;
+        for ( int i = first; i <= last && on_face; i++ ) on_face = intersect_face( i, tile, cell, face );
+        if ( on_face ) return;
+
+        // the face cast_column picked is only a guess, and near a corner it
+        // can be the wrong one. march the ends again and split the span
+        cast_column( first, get_column_angle( first ) );
+        cast_column( last, get_column_angle( last ) );
+    }
+
+    if ( last - first < 2 ) return;
+
+    const int middle = (first + last) / 2;
+    cast_column( middle, get_column_angle( middle ) );
+    cast_span( first, middle );
+    cast_span( middle, last );
+}
+
+// intersect a column's ray with one face of a wall tile and fill the column in
+// from that. returns whether the ray actually lands within the face
+bool Engine::intersect_face( const int column, const MapTile tile, const int cell, const WallFace face ) {
+    const float angle = get_column_angle( column );
+    const float dir_x = std::cos( angle );
+    const float dir_y = std::sin( angle );
+    const int cell_x = cell % map_width;
+    const int cell_y = cell / map_width;
+
+    float ray_length, along;
+    int along_start;
+    switch ( face ) {
+        case FaceWest:
+        case FaceEast: {
+            const float plane = face == FaceWest ? cell_x : cell_x + 1;
+            ray_length = (plane - camera.position.x) / dir_x;
+            along = camera.position.y + ray_length * dir_y;
+            along_start = cell_y;
+            column_hits.hit_x[ column ] = plane;
+            column_hits.hit_y[ column ] = along;
+            break;
+        }
+
+        default: {
+            const float plane = face == FaceNorth ? cell_y : cell_y + 1;
+            ray_length = (plane - camera.position.y) / dir_y;
+            along = camera.position.x + ray_length * dir_x;
+            along_start = cell_x;
+            column_hits.hit_x[ column ] = along;
+            column_hits.hit_y[ column ] = plane;
+            break;
+        }
+    }
+
+    // same texcoord convention as cast_column
+    int x_texcoord = (along - floor( along + .5 )) * wall_textures.get_size();
+    if ( x_texcoord < 0 ) x_texcoord += wall_textures.get_size();
+
+    column_hits.distance[ column ] = ray_length * std::cos( angle - camera.view_angle );
+    column_hits.ray_length[ column ] = ray_length;
+    column_hits.tile[ column ] = tile;
+    column_hits.cell[ column ] = cell;
+    column_hits.face[ column ] = face;
+    column_hits.texcoord[ column ] = x_texcoord;
+
+    return ray_length > 0 && along >= along_start && along <= along_start + 1;
+}
+
+void Engine::copy_column_hit( const int from, const int to ) {
+    column_hits.distance[ to ] = column_hits.distance[ from ];
+    column_hits.ray_length[ to ] = column_hits.ray_length[ from ];
+    column_hits.tile[ to ] = column_hits.tile[ from ];
+    column_hits.cell[ to ] = column_hits.cell[ from ];
+    column_hits.face[ to ] = column_hits.face[ from ];
+    column_hits.texcoord[ to ] = column_hits.texcoord[ from ];
+    column_hits.hit_x[ to ] = column_hits.hit_x[ from ];
+    column_hits.hit_y[ to ] = column_hits.hit_y[ from ];
+}
+
+void Engine::bake_lightmap() {
+    std::vector<uint8_t> solid( map.size() );
+    for ( size_t i = 0; i < map.size(); i++ ) solid[ i ] = map[ i ] != Floor;
+
+    lightmap.bake( solid, map_width, map_height, static_lights, workers );
+}
+
+// moves each glow light to where its enemy is now. done at the start of a
+// frame so the grid holds still while the passes read it
+void Engine::update_dynamic_lights() {
+    auto& glows = enemy_manager.get_components<GlowComponent>();
+    for ( size_t i = 0; i < glows.size(); i++ ) {
+        const auto move_comp = enemy_manager.get_component<MovementComponent>( glows.get_entity( i ) );
+        light_grid.move_light( glows[ i ].light, move_comp->x, move_comp->y );
+    }
+}
+
+void Engine::reset_hit_cache() {
+    // one bucket per column at the current fov, rounded so they wrap evenly
+    const size_t bucket_count = std::max( 1l, std::lround( 2 * M_PI / (camera.fov / (WINDOW_WIDTH / 2)) ) );
+
+    hit_cache.origin = camera.position;
+    hit_cache.fov = camera.fov;
+
+    // cached rays don't get marched again, so their cells stay marked for as
+    // long as the cache lasts
+    visible_cells.clear();
+    hit_cache.bucket_size = 2 * M_PI / bucket_count;
+    hit_cache.filled.assign( bucket_count, 0 );
+    hit_cache.ray_length.resize( bucket_count );
+    hit_cache.tile.resize( bucket_count );
+    hit_cache.cell.resize( bucket_count );
+    hit_cache.face.resize( bucket_count );
+    hit_cache.texcoord.resize( bucket_count );
+    hit_cache.hit_x.resize( bucket_count );
+    hit_cache.hit_y.resize( bucket_count );
+}
+
+void Engine::mark_dirty( const Rect rect ) {
+    const auto r = rect.clipped( Rect { 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT } );
+    if ( r.empty() ) return;
+
+    for ( auto& d : dirty_rects ) {
+        if ( d.contains( r ) ) return;
+    }
+
+    dirty_rects.erase( std::remove_if( dirty_rects.begin(), dirty_rects.end(),
+        [&r]( const Rect& d ) { return r.contains( d ); } ), dirty_rects.end() );
+    dirty_rects.push_back( r );
+}
+
+// work out which parts of the frame we just drew differ from the last one.
+// moving the camera changes everything, moving enemies only touches the
+// minimap and wherever their sprites were or now are
+void Engine::update_dirty_rects() {
+    const Rect minimap_rect = get_minimap_rect();
+    const Rect view_rect { WINDOW_WIDTH / 2, 0, WINDOW_WIDTH / 2, WINDOW_HEIGHT };
+
+    auto& movement = enemy_manager.get_components<MovementComponent>();
+    bool enemies_moved = last_enemy_positions.size() != movement.size();
+    last_enemy_positions.resize( movement.size() );
+    for ( size_t i = 0; i < movement.size(); i++ ) {
+        // the same place might hold a different enemy since last frame
+        const Entity enemy = movement.get_entity( i );
+        const Vec2 pos { movement[ i ].x, movement[ i ].y };
+        if ( last_enemy_positions[ i ].first != enemy || last_enemy_positions[ i ].second != pos ) enemies_moved = true;
+        last_enemy_positions[ i ] = { enemy, pos };
+    }
+
+    const bool camera_moved = last_camera_position != camera.position
+        || last_camera_angle != camera.view_angle;
+    last_camera_position = camera.position;
+    last_camera_angle = camera.view_angle;
+
+    if ( camera_moved ) {
+        minimap_stale = true;
+        mark_dirty( view_rect );
+    } else if ( enemies_moved || particles_drawn || last_particles_drawn ) {
+        minimap_stale = true;
+
+        int sprite_area = 0;
+        for ( auto& r : sprite_bounds ) sprite_area += r.w * r.h;
+        for ( auto& r : last_sprite_bounds ) sprite_area += r.w * r.h;
+
+        // past a point one big upload beats lots of small overlapping ones.
+        // with lighting on the enemies' glow lights moved too, which can
+        // change any wall in view
+        if ( lighting_enabled || sprite_area >= view_rect.w * view_rect.h ) {
+            mark_dirty( view_rect );
+        } else {
+            for ( auto& r : sprite_bounds ) mark_dirty( r );
+            for ( auto& r : last_sprite_bounds ) mark_dirty( r );
+        }
+    }
+
+    // on a lower minimap rate its changes go up with the frame that draws them
+    if ( minimap_stale && minimap_drawn ) {
+        mark_dirty( minimap_rect );
+        minimap_stale = false;
+    }
+
+    std::swap( sprite_bounds, last_sprite_bounds );
+    last_particles_drawn = particles_drawn;
 }
 
 void Engine::draw_rect( const int x, const int y, const int w, const int h, const Color color ) {
+    // looked up once and kept out of the loop, so the colour fill stays tight
+    if ( palette_mode ) {
+        const uint8_t index = palette.nearest( color );
+        for ( int i = 0; i < w; i++ ) {
+            for ( int j = 0; j < h; j++ ) index_framebuffer[ x + i + (y + j) * WINDOW_WIDTH ] = index;
+        }
+        return;
+    }
+
     for ( int i = 0; i < w; i++ ) {
         for ( int j = 0; j < h; j++ ) {
             const int cx = x + i;
@@ -226,91 +1073,296 @@ void Engine::draw_rect( const int x, const int y, const int w, const int h, cons
     }
 }
 
-void Engine::draw_sprite( const Entity enemy ) {
-    const auto move_comp = enemy_manager.get_movement_component( enemy );
-    const auto dist_comp = enemy_manager.get_distance_component( enemy );
-    const auto type_comp = enemy_manager.get_enemy_type_component( enemy );
-
-    float dir = atan2( move_comp->y - player.position.y, move_comp->x - player.position.x );
-    while ( dir - player.view_angle > M_PI ) dir -= 2 * M_PI;
-    while ( dir - player.view_angle < -M_PI ) dir += 2 * M_PI;
-
-    size_t sprite_size = std::min( 1000, static_cast<int>( WINDOW_HEIGHT / dist_comp->distance ) );
-    int h_offset = (dir - player.view_angle) / player.fov * (WINDOW_WIDTH / 2) + (WINDOW_WIDTH / 4) - (enemy_textures.get_size() / 2);
-    h_offset -= sprite_size / 2; // center the sprite
-    int v_offset = WINDOW_HEIGHT / 2 - sprite_size / 2;
-
-    for ( size_t i = 0; i < sprite_size; i++ ) {
-        if ( h_offset + int(i) < 0 || h_offset + i >= WINDOW_WIDTH / 2 ) continue;
-        if ( depth_buffer[ h_offset + i ] < dist_comp->distance ) continue; // occlude sprite
-        for ( size_t j = 0; j < sprite_size; j++ ) {
-            if ( v_offset + int(j) < 0 || v_offset + j >= WINDOW_HEIGHT ) continue;
-            auto col = enemy_textures.get_pixel( i * enemy_textures.get_size() / sprite_size, j * enemy_textures.get_size() / sprite_size, type_comp->type );
-            if ( (col.get_hex() & 0x000000FF) < 0x00000080 ) continue; // very simple alpha culling
-            int x, y;
-            x = WINDOW_WIDTH / 2 + h_offset + i;
-            y = v_offset + j;
-            draw_pixel( x, y, col );
+// bresenham, clipped to the framebuffer per pixel
+void Engine::draw_line( const int x0, const int y0, const int x1, const int y1, const Color color ) {
+    const int dx = std::abs( x1 - x0 );
+    const int dy = -std::abs( y1 - y0 );
+    const int sx = x0 < x1 ? 1 : -1;
+    const int sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy;
+    int x = x0;
+    int y = y0;
+
+    while ( true ) {
+        if ( x >= 0 && x < WINDOW_WIDTH && y >= 0 && y < WINDOW_HEIGHT )
+            draw_pixel( x, y, color );
+        if ( x == x1 && y == y1 ) break;
+
+        const int e2 = err * 2;
+        if ( e2 >= dy ) {
+            err += dy;
+            x += sx;
+        }
+        if ( e2 <= dx ) {
+            err += dx;
+            y += sy;
         }
     }
 }
 
+// index is into the movement components and the sprite batch. false if the
+// sprite doesn't need drawing at all
+bool Engine::prepare_sprite( const size_t index, SpriteDraw& draw ) {
+    const Entity enemy = enemy_manager.get_components<MovementComponent>().get_entity( index );
+    draw.type = enemy_manager.get_component<EnemyTypeComponent>( enemy )->type;
+    draw.distance = sprite_batch.distance[ index ];
+
+    draw.size = std::min( 1000, static_cast<int>( WINDOW_HEIGHT / draw.distance ) );
+    if ( sprite_cache_enabled ) draw.size = SpriteCache::quantize_size( draw.size );
+    draw.h_offset = sprite_batch.screen_x[ index ];
+    draw.h_offset -= draw.size / 2; // center the sprite
+    draw.v_offset = WINDOW_HEIGHT / 2 - draw.size / 2;
+
+    draw.begin = std::max( 0, draw.h_offset );
+    draw.end = std::min( WINDOW_WIDTH / 2, draw.h_offset + draw.size );
+    if ( draw.begin >= draw.end ) return false;
+
+    // one query tells us if the walls hide all of the sprite, none of it or
+    // some of it, and only the last needs a depth test per column
+    float nearest_wall, furthest_wall;
+    depth_tree.query( draw.begin, draw.end, nearest_wall, furthest_wall );
+    if ( furthest_wall < draw.distance ) return false;
+    draw.unoccluded = nearest_wall >= draw.distance;
+
+    const auto bounds = Rect { WINDOW_WIDTH / 2 + draw.h_offset, draw.v_offset, draw.size, draw.size }
+        .clipped( Rect { WINDOW_WIDTH / 2, 0, WINDOW_WIDTH / 2, WINDOW_HEIGHT } );
+    if ( !bounds.empty() ) sprite_bounds.push_back( bounds );
+
+    // sprites only get ambient and the moving lights, the baked ones are per face
+    int light = 255;
+    if ( lighting_enabled ) {
+        const int cell = int(sprite_batch.world_x[ index ]) + int(sprite_batch.world_y[ index ]) * map_width;
+        light = LIGHT_AMBIENT * 255 + light_grid.sample( cell );
+    }
+
+    ShadeLevel level;
+    const ShadeLevel* shade = get_shade_level( draw.distance, light, level );
+    draw.shaded = shade != nullptr;
+    if ( shade ) draw.shade = *shade;
+    draw.color_map = palette_mode ? get_color_map( draw.distance, light ) : nullptr;
+    // the cache only holds alpha tested sprites
+    draw.scaled = sprite_cache_enabled && !draw.blended ? sprite_cache.get( enemy_textures, draw.type, draw.size ) : nullptr;
+    return true;
+}
+
+// draws the columns of a sprite within [first_column, last_column). different
+// column ranges touch different pixels and coverage, so they can be drawn at
+// the same time
+void Engine::draw_sprite( const SpriteDraw& draw, const int first_column, const int last_column ) {
+    const int begin = std::max( draw.begin, first_column );
+    const int end = std::min( draw.end, last_column );
+    if ( begin >= end ) return;
+
+    const size_t tex_size = enemy_textures.get_size();
+    const ShadeLevel* shade = draw.shaded ? &draw.shade : nullptr;
+    const int top = std::max( 0, draw.v_offset );
+    const int bottom = std::min( WINDOW_HEIGHT, draw.v_offset + draw.size );
+    for ( int column = begin; column < end; column++ ) {
+        if ( !draw.unoccluded && column_hits.distance[ column ] < draw.distance ) continue; // occlude sprite
+
+        // nearer sprites have already filled this column
+        uint64_t* coverage = nullptr;
+        if ( sprites_front_to_back && !draw.blended ) {
+            coverage = &sprite_coverage[ column * COVERAGE_WORDS ];
+            if ( rows_covered( coverage, top, bottom ) ) continue;
+        }
+
+        const int x = WINDOW_WIDTH / 2 + column;
+        const size_t i = column - draw.h_offset; // column within the sprite
+        if ( draw.scaled ) {
+            size_t span_count;
+            const auto spans = draw.scaled->get_column_spans( i, span_count );
+            if ( span_count == 0 ) continue;
+
+            const size_t offset = draw.scaled->pixel_offsets[ i ];
+            if ( palette_mode ) {
+                scaled_sprite_column_kernel( &index_framebuffer[ x ], WINDOW_WIDTH, &draw.scaled->indices[ offset ],
+                    spans, span_count, draw.v_offset, WINDOW_HEIGHT, draw.color_map, coverage );
+            } else {
+                scaled_sprite_column_kernel( &framebuffer[ x ], WINDOW_WIDTH, &draw.scaled->pixels[ offset ],
+                    spans, span_count, draw.v_offset, WINDOW_HEIGHT, shade, coverage );
+            }
+            continue;
+        }
+
+        const size_t tex_x = i * tex_size / draw.size;
+        if ( draw.blended ) {
+            // premultiplied texels are unchanged where they're fully opaque, so
+            // those runs go through the usual kernel
+            const auto texels = enemy_textures.get_column_premultiplied( draw.type, tex_x );
+            size_t span_count;
+            const auto solid = enemy_textures.get_column_solid_spans( draw.type, tex_x, span_count );
+            if ( span_count > 0 ) {
+                sprite_kernel( &framebuffer[ x ], WINDOW_WIDTH, texels, solid, span_count,
+                    tex_size, draw.size, draw.v_offset, WINDOW_HEIGHT, shade, nullptr );
+            }
+
+            const auto translucent = enemy_textures.get_column_translucent_spans( draw.type, tex_x, span_count );
+            if ( span_count > 0 ) {
+                sprite_blend_kernel( &framebuffer[ x ], WINDOW_WIDTH, texels, translucent, span_count,
+                    tex_size, draw.size, draw.v_offset, WINDOW_HEIGHT, shade ? *shade : ShadeLevel { 256, 0, 0 } );
+            }
+            continue;
+        }
+
+        size_t span_count;
+        const auto spans = enemy_textures.get_column_spans( draw.type, tex_x, span_count );
+        if ( span_count == 0 ) continue;
+
+        if ( palette_mode ) {
+            const auto indices = enemy_textures.get_column_indices( draw.type, tex_x );
+            indexed_sprite_kernel( &index_framebuffer[ x ], WINDOW_WIDTH, indices, spans, span_count,
+                tex_size, draw.size, draw.v_offset, WINDOW_HEIGHT, draw.color_map, coverage );
+            continue;
+        }
+
+        const auto texels = enemy_textures.get_column_data( draw.type, tex_x );
+        sprite_kernel( &framebuffer[ x ], WINDOW_WIDTH, texels, spans, span_count,
+            tex_size, draw.size, draw.v_offset, WINDOW_HEIGHT, shade, coverage );
+    }
+}
+
+// the minimap view cone is built from the wall pass' hits rather than every ray
+// sample, so its cost stays separate from the 3d view
+void Engine::draw_view_cone( const size_t rect_w, const size_t rect_h ) {
+    const int origin_x = camera.position.x * rect_w;
+    const int origin_y = camera.position.y * rect_h;
+    const Color cone_color( 0x5555DDFF );
+
+    for ( int i = 0; i < WINDOW_WIDTH / 2; i++ ) {
+        draw_line( origin_x, origin_y, column_hits.hit_x[ i ] * rect_w, column_hits.hit_y[ i ] * rect_h, cone_color );
+    }
+}
+
+// draws a column's wall across width screen columns
+void Engine::draw_wall_column( const int column, const int width ) {
+    const Color clear_color( 0xBBBBBBFF );
+    const int pixel_x = column + WINDOW_WIDTH / 2;
+    const auto tile = column_hits.tile[ column ];
+
+    // the floor pass fills in around the walls when it's on
+    const bool clear = floor_texture < 0 || ceiling_texture < 0;
+
+    if ( tile == Floor ) {
+        if ( clear ) draw_rect( pixel_x, 0, width, WINDOW_HEIGHT, clear_color );
+        return;
+    }
+
+    // anything closer than a ray step would blow the column height up
+    const int column_height = WINDOW_HEIGHT / std::max( column_hits.distance[ column ], .01f );
+    const size_t tex_size = wall_textures.get_size();
+    const int texcoord = column_hits.texcoord[ column ];
+    const auto texels = wall_textures.get_column_data( tile, texcoord );
+
+    // light is constant down a column, so it just folds into the column's
+    // fog level and costs nothing per pixel
+    int light = 255;
+    if ( lighting_enabled ) {
+        const int cell = column_hits.cell[ column ];
+        const int face = column_hits.face[ column ];
+        const int front_cell = cell + (face == FaceWest ? -1 : face == FaceEast ? 1 : 0)
+            + (face == FaceNorth ? -int(map_width) : face == FaceSouth ? map_width : 0);
+
+        light = lightmap.sample( cell, face, (texcoord + .5f) / tex_size ) + light_grid.sample( front_cell );
+    }
+
+    if ( palette_mode ) {
+        indexed_wall_kernel( &index_framebuffer[ pixel_x ], WINDOW_WIDTH, width,
+            wall_textures.get_column_indices( tile, texcoord ), tex_size, column_height, WINDOW_HEIGHT,
+            palette.nearest( clear_color ), clear, get_color_map( column_hits.distance[ column ], light ) );
+        return;
+    }
+
+    ShadeLevel level;
+    const ShadeLevel* shade = get_shade_level( column_hits.distance[ column ], light, level );
+
+    wall_kernel( &framebuffer[ pixel_x ], WINDOW_WIDTH, width, texels, tex_size,
+        column_height, WINDOW_HEIGHT, clear_color, clear, shade );
+}
+
 void Engine::draw_pixel( const int x, const int y, const Color color ) {
-    framebuffer[ x + y * WINDOW_WIDTH ] = color;
+    if ( palette_mode ) index_framebuffer[ x + y * WINDOW_WIDTH ] = palette.nearest( color );
+    else framebuffer[ x + y * WINDOW_WIDTH ] = color;
 }
 
 MapTile Engine::get_map_tile( const int x, const int y ) const {
     return map[ x + y * map_width ];
 }
 
+float Engine::get_column_angle( const int column ) const {
+    return camera.view_angle - camera.fov / 2 + camera.fov * column / float(WINDOW_WIDTH / 2);
+}
+
+// the column of the 3d view straight ahead of the camera, as far as sprites
+// and particles are concerned. the odd texture size offset keeps sprites where
+// they've always been drawn, and particles go through the same projection so
+// they line up with the sprites
+float Engine::get_sprite_centre_column() {
+    return WINDOW_WIDTH / 4 - int(enemy_textures.get_size() / 2);
+}
+
+const ShadeLevel* Engine::get_fog_level( const float distance ) const {
+    return fog_enabled ? &fog_table.lookup( distance ) : nullptr;
+}
+
+// fog and light (0 - 255, clamped) combined into one level. uses level for
+// storage when it needs to, nullptr means leave the colour alone
+const ShadeLevel* Engine::get_shade_level( const float distance, const int light, ShadeLevel& level ) const {
+    const ShadeLevel* fog = get_fog_level( distance );
+    if ( light >= 255 ) return fog;
+
+    level = fog ? *fog : ShadeLevel { 256, 0, 0 };
+    level.scale = (level.scale * light_scales[ light ]) >> 8;
+    return &level;
+}
+
+// the palette mode version of get_shade_level, nullptr when there's nothing to do
+const ColorMap* Engine::get_color_map( const float distance, const int light ) const {
+    if ( light >= 255 && !fog_enabled ) return nullptr;
+    return &palette.get_color_map( fog_enabled ? distance : 0, light );
+}
+
+Rect Engine::get_minimap_rect() const {
+    const int rect_w = WINDOW_WIDTH / (map_width * 2);
+    const int rect_h = WINDOW_HEIGHT / map_height;
+    return Rect { 0, 0, int(map_width) * rect_w, int(map_height) * rect_h };
+}
+
 void Engine::add_enemy( const float x, const float y, const float speed, const EnemyType type ) {
     auto id = enemy_manager.register_entity();
     if ( id.has_value() ) {
         const auto id_val = id.value();
-        const auto move_comp = enemy_manager.get_movement_component( id_val );
-        const auto type_comp = enemy_manager.get_enemy_type_component( id_val );
-
-        *move_comp = { x, y, speed };
-        *type_comp = { type };
+        enemy_manager.add_component( id_val, MovementComponent { x, y, speed } );
+        enemy_manager.add_component( id_val, EnemyTypeComponent { type } );
+        enemy_manager.add_component( id_val, DistanceComponent { 0.0f } );
+        enemy_manager.add_component( id_val, SightComponent { false } );
+        enemy_manager.add_component( id_val, GlowComponent {
+            light_grid.add_light( Light { x, y, ENEMY_GLOW_RADIUS, ENEMY_GLOW_INTENSITY } )
+        } );
 
-        active_enemies.push_back( id.value() );
+        sprite_order.add( id_val );
     }
 }
 
 void Engine::enemy_movement_system( const float delta_time ) {
-    for ( auto& e : active_enemies ) {
-        auto move_comp = enemy_manager.get_movement_component( e );
-        auto dist_comp = enemy_manager.get_distance_component( e );
-
-        // simplified raycast to check if the player can be seen by the enemy
-        int x1, y1, x2, y2;
-        if ( move_comp->x > player.position.x ) {
-            x1 = player.position.x;
-            y1 = player.position.y;
-            x2 = move_comp->x;
-            y2 = move_comp->y;
-        } else {
-            x1 = move_comp->x;
-            y1 = move_comp->y;
-            x2 = player.position.x;
-            y2 = player.position.y;
-        }
+    visible_cells_lock.lock();
 
-        const int dx = x2 - x1;
-        const int dy = y2 - y1;
+    auto& movement = enemy_manager.get_components<MovementComponent>();
+    for ( size_t i = 0; i < movement.size(); i++ ) {
+        const auto e = movement.get_entity( i );
+        auto move_comp = &movement[ i ];
+        auto dist_comp = enemy_manager.get_component<DistanceComponent>( e );
+        auto sight_comp = enemy_manager.get_component<SightComponent>( e );
 
-        bool can_see_player = true;
-        for ( int x = x1; x < x2; ++x ) {
-            int y = y1 + dy * (x - x1) / dx;
-            if ( map[ x + y * map_width ] != MapTile::Floor ) {
-                can_see_player = false;
-                break;
-            }
+        // enemies out of view take turns checking, a few each update
+        const bool in_view = shared_visible_cells.contains_near( move_comp->x, move_comp->y );
+        if ( in_view || (update_count + i) % UNSEEN_ENEMY_CHECK_INTERVAL == 0 ) {
+            sight_comp->can_see = can_see_player( move_comp->x, move_comp->y );
         }
 
         // TODO: magic number
         // only move if we are far enough away and can see the player
-        if ( dist_comp->distance > 1.0f && can_see_player ) {
+        if ( dist_comp->distance > 1.0f && sight_comp->can_see ) {
             auto dir = Vec2 {
                 player.position.x - move_comp->x,
                 player.position.y - move_comp->y
@@ -325,4 +1377,33 @@ void Engine::enemy_movement_system( const float delta_time ) {
         float enemy_dist = std::sqrt( pow( player.position.x - move_comp->x, 2 ) + pow( player.position.y - move_comp->y, 2 ) );
         dist_comp->distance = enemy_dist;
     }
+
+    visible_cells_lock.unlock();
+    update_count++;
+}
+
+// simplified raycast to check if the player can be seen from a point
+bool Engine::can_see_player( const float from_x, const float from_y ) const {
+    int x1, y1, x2, y2;
+    if ( from_x > player.position.x ) {
+        x1 = player.position.x;
+        y1 = player.position.y;
+        x2 = from_x;
+        y2 = from_y;
+    } else {
+        x1 = from_x;
+        y1 = from_y;
+        x2 = player.position.x;
+        y2 = player.position.y;
+    }
+
+    const int dx = x2 - x1;
+    const int dy = y2 - y1;
+
+    for ( int x = x1; x < x2; ++x ) {
+        int y = y1 + dy * (x - x1) / dx;
+        if ( map[ x + y * map_width ] != MapTile::Floor ) return false;
+    }
+
+    return true;
 }
@@ -5,6 +5,37 @@
 #define WINDOW_HEIGHT 512
 #define FRAMEBUFFER_LENGTH WINDOW_WIDTH * WINDOW_HEIGHT
 
+// widest run of columns the span caster will fill from two rays. a wall tile
+// within max ray range is always wider than this many columns, so nothing can
+// hide entirely between two rays that hit the same face
+#define WALL_SPAN_WIDTH 16
+
+// camera movement between two frames past which the interlaced caster gives up
+// on reprojecting and recasts every column
+#define INTERLACE_MAX_MOVE 0.25f
+#define INTERLACE_MAX_TURN_COLUMNS 32
+
+// every enemy carries a small moving light around with it
+#define ENEMY_GLOW_RADIUS 2.5f
+#define ENEMY_GLOW_INTENSITY 0.5f
+
+// the haze distant walls fade into when fog is turned on, as rgba, and how
+// quickly it thickens with distance
+#define FOG_COLOR 0x101018FF
+#define FOG_DENSITY 0.15f
+
+// enemies nowhere near the player's view only check whether they can see the
+// player once every this many updates
+#define UNSEEN_ENEMY_CHECK_INTERVAL 8
+
+// 64 bit words of sprite coverage per column of the 3d view
+#define COVERAGE_WORDS ((WINDOW_HEIGHT + 63) / 64)
+
+// columns of the 3d view per sprite tile. each tile draws its own columns of
+// every sprite that overlaps it, so tiles can go to different threads
+#define SPRITE_TILE_WIDTH 16
+#define SPRITE_TILE_COUNT ((WINDOW_WIDTH / 2 + SPRITE_TILE_WIDTH - 1) / SPRITE_TILE_WIDTH)
+
 #include <iostream>
 #include <fstream>
 #include <string>
@@ -14,11 +45,25 @@
 #include <array>
 #include <algorithm>
 #include <mutex>
+#include <chrono>
+#include <sstream>
 
 #include "color.h"
 #include "player.h"
+#include "rect.h"
 #include "texture.h"
+#include "render_kernels.h"
+#include "shading.h"
+#include "lighting.h"
+#include "light_grid.h"
+#include "min_max_tree.h"
+#include "depth_order.h"
+#include "cell_set.h"
+#include "sprite_cache.h"
+#include "particles.h"
+#include "worker_pool.h"
 #include "entity_engine.h"
+#include "components.h"
 
 enum MapTile {
     Floor = -1,
@@ -28,40 +73,272 @@ enum MapTile {
     Wall4 = 3
 };
 
+// which side of a wall tile a ray ran into
+enum WallFace {
+    FaceWest = 0,
+    FaceEast = 1,
+    FaceNorth = 2,
+    FaceSouth = 3
+};
+
+enum RenderPassId {
+    CastPass = 0,
+    ShadePass,
+    FloorPass,
+    MinimapPass,
+    SpritePass,
+    ParticlePass,
+    RENDER_PASS_COUNT
+};
+
+// different ways the cast pass can fill in the column hits
+enum CastMode {
+    CastEveryColumn = 0, // march a fresh ray for every column
+    CastCached,          // reuse hits from the angular hit cache where we can
+    CastSpans,           // only cast at wall span boundaries and fill in between
+    CastInterlaced,      // cast half the columns, reproject the rest from last frame
+    CAST_MODE_COUNT
+};
+
+// per-column output of the cast pass, one array per field so the later passes
+// only touch what they need. lives on the engine and gets reused every frame
+struct ColumnHits {
+    std::array<float, WINDOW_WIDTH / 2> distance; // perpendicular, doubles as the depth buffer
+    std::array<float, WINDOW_WIDTH / 2> ray_length;
+    std::array<MapTile, WINDOW_WIDTH / 2> tile;
+    std::array<int, WINDOW_WIDTH / 2> cell; // map index of the tile that was hit
+    std::array<WallFace, WINDOW_WIDTH / 2> face;
+    std::array<int, WINDOW_WIDTH / 2> texcoord;
+    std::array<float, WINDOW_WIDTH / 2> hit_x;
+    std::array<float, WINDOW_WIDTH / 2> hit_y;
+};
+
+// the active enemies moved into camera space together at the start of the
+// sprite pass, indexed like the movement components
+struct SpriteBatch {
+    std::vector<float> world_x;
+    std::vector<float> world_y;
+    std::vector<float> depth;    // along the view direction, <= 0 is behind the camera
+    std::vector<float> distance; // straight line from the camera, sets the size
+    std::vector<float> screen_x; // column of the 3d view the centre lands on
+};
+
+// everything needed to draw a sprite, worked out once before it's split up
+// between the tiles it overlaps
+struct SpriteDraw {
+    size_t type;
+    float distance;
+    int size;
+    int h_offset; // column of the 3d view the left edge lands on
+    int v_offset;
+    int begin;    // the columns actually on screen
+    int end;
+    bool unoccluded; // no wall in front of any of it
+    bool blended;
+    bool shaded;
+    ShadeLevel shade;
+    const ColorMap* color_map;
+    const ScaledSprite* scaled; // from the sprite cache, if it's on
+};
+
+// wall hits as seen from a single point, bucketed by absolute ray angle so that
+// a pure rotation can reuse what's already been traced. moving the point or
+// changing the map throws the lot away
+struct HitCache {
+    Vec2 origin;
+    float fov;
+    float bucket_size; // radians per bucket
+    std::vector<uint8_t> filled;
+    std::vector<float> ray_length;
+    std::vector<MapTile> tile;
+    std::vector<int> cell;
+    std::vector<WallFace> face;
+    std::vector<int> texcoord;
+    std::vector<float> hit_x;
+    std::vector<float> hit_y;
+};
+
 class Engine {
 public:
     Engine( const std::string map_path, const std::string wall_tex_path, const std::string enemy_tex_path );
     void update( const float delta_time );
     void render();
     void get_framebuffer( uint8_t* target );
+    void get_dirty_framebuffer( uint8_t* target, std::vector<Rect>& regions );
 
     void move_view( const float delta );
     void set_player_move_dir( const Vec2 dir );
+    void set_minimap_interval( const int frames );
+    void set_cast_mode( const CastMode mode );
+    void set_shading_rates( const float centre_fraction, const int edge_rate );
+    void set_floor_textures( const int floor_index, const int ceiling_index );
+    void set_fog( const bool enabled, const Color color, const float density );
+    void set_lighting_enabled( const bool enabled );
+    void set_palette_mode( const bool enabled );
+    void set_sprites_front_to_back( const bool enabled );
+    void set_sprite_cache_enabled( const bool enabled );
+    void set_sprite_blending( const bool enabled );
+    void set_map_tile( const int x, const int y, const MapTile tile );
+    void emit_particles( const ParticleBurst& burst );
+    Player get_player();
+    float get_pass_time_ms( const RenderPassId pass );
+    SpriteCacheStats get_sprite_cache_stats();
 
 private:
     Color framebuffer[ FRAMEBUFFER_LENGTH ];
+    uint8_t index_framebuffer[ FRAMEBUFFER_LENGTH ]; // drawn into instead in palette mode
     std::vector<MapTile> map;
     unsigned int map_width;
     unsigned int map_height;
     Player player;
+    Player camera; // snapshot of the player taken at the start of each frame
     Texture wall_textures;
     Texture enemy_textures;
+    WallColumnKernel wall_kernel;     // picked to suit the textures at load
+    SpriteColumnKernel sprite_kernel;
+    SpriteBlendKernel sprite_blend_kernel;
+    FloorRowKernel floor_kernel;
+    IndexedWallColumnKernel indexed_wall_kernel;
+    IndexedSpriteColumnKernel indexed_sprite_kernel;
+    IndexedFloorRowKernel indexed_floor_kernel;
+    WorkerPool workers;
+
+    // 8 bit mode: everything is drawn as palette indices and only expanded to
+    // rgba when the frame is copied out
+    Palette palette;
+    bool palette_mode;
+
+    // wall texture indices used for the floor and ceiling, -1 for flat colour
+    int floor_texture;
+    int ceiling_texture;
+    std::array<float, WINDOW_WIDTH / 2> column_tans;
+    std::array<int, WINDOW_WIDTH / 2> floor_start;
+    std::array<int, WINDOW_WIDTH / 2> ceiling_end;
+
+    FogTable fog_table;
+    bool fog_enabled;
+
+    std::vector<Light> static_lights; // from the map file
+    Lightmap lightmap;
+    bool lighting_enabled;
+    std::array<uint32_t, 256> light_scales; // lightmap sample to shade scale
+    LightGrid light_grid; // moving lights, on top of the baked ones
+    unsigned int update_count;
+
+    // map cells the cast pass' rays went through. the update thread reads its
+    // own copy, taken once a frame
+    CellSet visible_cells;
+    CellSet shared_visible_cells;
+    // every enemy has a movement component, and the sprite batch is lined up
+    // with those packed movement components each frame
     EntityEngine enemy_manager;
-    std::vector<Entity> active_enemies;
-    std::array<float, WINDOW_WIDTH> depth_buffer;
+    ColumnHits column_hits;
+    MinMaxTree depth_tree; // over column_hits.distance, rebuilt for the sprite pass
+    // enemies far to near. kept by entity, since an enemy's place among the
+    // movement components changes whenever another one is removed
+    DepthOrder sprite_order;
+    SpriteBatch sprite_batch;
+    std::vector<SpriteDraw> sprite_draws; // the sprites that survived culling, in drawing order
+    std::array<std::vector<uint32_t>, SPRITE_TILE_COUNT> sprite_tiles; // sprite_draws overlapping each tile
+
+    // front to back sprites keep a bit per pixel of the 3d view, column by
+    // column, for what's already been drawn
+    bool sprites_front_to_back;
+    std::vector<uint64_t> sprite_coverage;
+
+    // with the cache on, sprite sizes are quantised and each type and size is
+    // only scaled once
+    bool sprite_cache_enabled;
+    SpriteCache sprite_cache;
+
+    // blended sprites draw their partly see-through texels over what's behind
+    // them instead of alpha testing. only in full colour, and always back to
+    // front
+    bool sprite_blending;
+
+    // simulated on the update thread, the particle pass takes what it needs
+    // into the batch under the lock
+    ParticleSystem particles;
+    ParticleBatch particle_batch;
+    bool particles_drawn;
+    bool last_particles_drawn;
+    HitCache hit_cache;
+
+    // how many columns each column is drawn across: the first column of a group
+    // holds the group's width and the rest hold 0. all 1s is full density
+    std::array<uint8_t, WINDOW_WIDTH / 2> column_rates;
+
+    // what the interlaced caster reprojects from
+    ColumnHits previous_hits;
+    Player previous_camera;
+    bool previous_hits_valid;
+    int interlace_phase;
+
+    // the minimap can be drawn less often than the 3d view. what changed on it
+    // since it was last drawn waits in minimap_stale for the next time it is
+    int minimap_interval;
+    int minimap_phase;
+    bool minimap_drawn;
+    bool minimap_stale;
+
+    // the frame is built by running these in order, each one can be swapped
+    // out for a different implementation and is timed on its own
+    std::array<void (Engine::*)(), RENDER_PASS_COUNT> render_passes;
+    std::array<float, RENDER_PASS_COUNT> pass_times;
+
+    // regions changed since the last get_dirty_framebuffer call, and what was
+    // on screen last frame so we can tell what moved
+    std::vector<Rect> dirty_rects;
+    std::vector<Rect> sprite_bounds;
+    std::vector<Rect> last_sprite_bounds;
+    std::vector<std::pair<Entity, Vec2>> last_enemy_positions; // lined up with the movement components
+    Vec2 last_camera_position;
+    float last_camera_angle;
 
     std::mutex framebuffer_lock;
     std::mutex player_view_lock;
     std::mutex player_move_dir_lock;
+    std::mutex visible_cells_lock;
+    std::mutex particles_lock;
+
+    void cast_pass();
+    void cached_cast_pass();
+    void span_cast_pass();
+    void interlaced_cast_pass();
+    void shade_pass();
+    void floor_pass();
+    void minimap_pass();
+    void sprite_pass();
+    void particle_pass();
 
-    void clear_framebuffer( const Color color );
+    void cast_column( const int column, const float angle );
+    void copy_column_hit( const int from, const int to );
+    void cast_span( const int first, const int last );
+    bool intersect_face( const int column, const MapTile tile, const int cell, const WallFace face );
+    void reset_hit_cache();
+    void bake_lightmap();
+    void update_dynamic_lights();
+    void mark_dirty( const Rect rect );
+    void update_dirty_rects();
     void draw_rect( const int x, const int y, const int w, const int h, const Color color );
-    void draw_sprite( const Entity enemy );
+    void draw_line( const int x0, const int y0, const int x1, const int y1, const Color color );
+    void project_sprites();
+    bool prepare_sprite( const size_t index, SpriteDraw& draw );
+    void draw_sprite( const SpriteDraw& draw, const int first_column, const int last_column );
+    void draw_view_cone( const size_t rect_w, const size_t rect_h );
+    void draw_wall_column( const int column, const int width );
     void draw_pixel( const int x, const int y, const Color color );
 
     MapTile get_map_tile( const int x, const int y ) const;
+    const ShadeLevel* get_fog_level( const float distance ) const;
+    const ShadeLevel* get_shade_level( const float distance, const int light, ShadeLevel& level ) const;
+    const ColorMap* get_color_map( const float distance, const int light ) const;
+    float get_column_angle( const int column ) const;
+    float get_sprite_centre_column();
+    Rect get_minimap_rect() const;
     void add_enemy( const float x, const float y, const float speed, const EnemyType type );
     void enemy_movement_system( const float delta_time );
+    bool can_see_player( const float from_x, const float from_y ) const;
 };
 
 #endif
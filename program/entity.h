@@ -0,0 +1,24 @@
+#ifndef ENTITY_H
+#define ENTITY_H
+
+#include <cstdint>
+
+// an entity is a slot index in the low bits and the slot's generation in the
+// high bits. the generation goes up every time the slot is freed, so a handle
+// kept after its entity was unregistered no longer matches and can be caught
+#define ENTITY_INDEX_BITS 20
+#define ENTITY_GENERATION_BITS 12
+#define MAX_ENTITIES (1 << ENTITY_INDEX_BITS)
+#define ENTITY_INDEX_MASK (MAX_ENTITIES - 1)
+#define ENTITY_MAX_GENERATION ((1 << ENTITY_GENERATION_BITS) - 1)
+typedef uint32_t Entity;
+
+inline uint32_t entity_index( const Entity id ) {
+    return id & ENTITY_INDEX_MASK;
+}
+
+inline uint32_t entity_generation( const Entity id ) {
+    return id >> ENTITY_INDEX_BITS;
+}
+
+#endif
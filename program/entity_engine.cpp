@@ -1,52 +1,62 @@
 #include "entity_engine.h"
 
-EntityEngine::EntityEngine() {
-    for ( size_t i = 0; i < MAX_ENTITIES; i++ ) {
-        available_ids.push( i );
-    }
+// marks the end of the free list
+#define NO_FREE_SLOT 0xFFFFFFFF
 
-    movement_components = new MovementComponent[ MAX_ENTITIES ];
-    enemy_type_components = new EnemyTypeComponent[ MAX_ENTITIES ];
-    distance_components = new DistanceComponent[ MAX_ENTITIES ];
-}
+EntityEngine::EntityEngine() : free_head( NO_FREE_SLOT ), free_tail( NO_FREE_SLOT ), live_count( 0 ) {}
+
+std::optional<Entity> EntityEngine::register_entity() {
+    uint32_t index;
+
+    if ( free_head != NO_FREE_SLOT ) {
+        index = free_head;
+        free_head = next_free[ index ];
+        if ( free_head == NO_FREE_SLOT ) free_tail = NO_FREE_SLOT;
+    } else if ( generations.size() < MAX_ENTITIES ) {
+        index = generations.size();
+        generations.push_back( 0 );
+        next_free.push_back( NO_FREE_SLOT );
+    } else {
+        return std::nullopt;
+    }
 
-EntityEngine::~EntityEngine() {
-    delete [] movement_components;
-    delete [] enemy_type_components;
-    delete [] distance_components;
+    live_count++;
+    return Entity( index | (generations[ index ] << ENTITY_INDEX_BITS) );
 }
 
-std::optional<Entity> EntityEngine::register_entity() {
-    std::optional<Entity> to_return;
+bool EntityEngine::unregister_entity( const Entity id ) {
+    if ( !is_alive( id ) ) return false;
 
-    if ( available_ids.size() > 0 ) {
-        to_return = available_ids.front();
-        available_ids.pop();
+    for ( auto& set : component_sets ) {
+        if ( set ) set->remove( id );
     }
 
-    // clean the data up from anything that might have been there previously
-    if ( to_return.has_value() ) {
-        auto id = to_return.value();
-        movement_components[ id ] = MovementComponent { 0.0f, 0.0f, 0.0f };
-        enemy_type_components[ id ] = EnemyTypeComponent { EnemyType::YeeHaw };
-        distance_components[ id ] = DistanceComponent { 0.0f };
-    }
+    const uint32_t index = entity_index( id );
+    live_count--;
 
-    return to_return;
-}
+    // a slot whose generation has run out is retired rather than risk a new
+    // handle matching a very old one. its generation is left past anything a
+    // handle can hold, so nothing matches it again
+    generations[ index ]++;
+    if ( generations[ index ] > ENTITY_MAX_GENERATION ) return true;
 
-void EntityEngine::unregister_entity( const Entity id ) {
-    available_ids.push( id );
-}
+    next_free[ index ] = NO_FREE_SLOT;
+    if ( free_tail == NO_FREE_SLOT ) {
+        free_head = index;
+    } else {
+        next_free[ free_tail ] = index;
+    }
+    free_tail = index;
 
-MovementComponent* EntityEngine::get_movement_component( const Entity id ) const {
-    return &movement_components[ id ];
+    return true;
 }
 
-EnemyTypeComponent* EntityEngine::get_enemy_type_component( const Entity id ) const {
-    return &enemy_type_components[ id ];
+bool EntityEngine::is_alive( const Entity id ) const {
+    const uint32_t index = entity_index( id );
+    // a free slot has already moved on a generation, so this catches those too
+    return index < generations.size() && generations[ index ] == entity_generation( id );
 }
 
-DistanceComponent* EntityEngine::get_distance_component( const Entity id ) const {
-    return &distance_components[ id ];
+size_t EntityEngine::get_count() const {
+    return live_count;
 }
@@ -1,32 +1,64 @@
 #ifndef ENTITY_ENGINE_H
 #define ENTITY_ENGINE_H
 
-#include <queue>
+#include <vector>
+#include <memory>
 #include <cstdint>
 #include <optional>
 
-#include "components.h"
-
-#define MAX_ENTITIES 0xFF
-typedef uint8_t Entity;
+#include "entity.h"
+#include "component_set.h"
 
+// hands out entities and keeps a component set for each component type. any
+// struct can be a component, its set is made the first time it's asked for,
+// so ask for every type before more than one thread is using the engine
 class EntityEngine {
 public:
     EntityEngine();
-    ~EntityEngine();
 
+    // empty once all MAX_ENTITIES slots are in use
     std::optional<Entity> register_entity();
-    void unregister_entity( const Entity id );
+    // takes all its components with it. false if the handle is stale,
+    // nothing is freed twice
+    bool unregister_entity( const Entity id );
+    bool is_alive( const Entity id ) const;
+    size_t get_count() const;
+
+    template <typename T>
+    ComponentSet<T>& get_components() {
+        const size_t type = component_type<T>();
+        if ( type >= component_sets.size() ) component_sets.resize( type + 1 );
+        if ( !component_sets[ type ] ) component_sets[ type ].reset( new ComponentSet<T>() );
+        return *static_cast<ComponentSet<T>*>( component_sets[ type ].get() );
+    }
+
+    // null for a stale handle
+    template <typename T>
+    T* add_component( const Entity id, const T& component ) {
+        return is_alive( id ) ? get_components<T>().add( id, component ) : nullptr;
+    }
 
-    MovementComponent* get_movement_component( const Entity id ) const;
-    EnemyTypeComponent* get_enemy_type_component( const Entity id ) const;
-    DistanceComponent* get_distance_component( const Entity id ) const;
+    // null for a stale handle or one without the component
+    template <typename T>
+    T* get_component( const Entity id ) {
+        return get_components<T>().get( id );
+    }
+
+    template <typename T>
+    void remove_component( const Entity id ) {
+        get_components<T>().remove( id );
+    }
 
 private:
-    std::queue<Entity> available_ids;
-    MovementComponent* movement_components;
-    EnemyTypeComponent* enemy_type_components;
-    DistanceComponent* distance_components;
+    // freed slots queue up oldest first, linked through next_free, so a slot
+    // isn't reused straight away and its generation climbs slowly
+    std::vector<uint32_t> generations;
+    std::vector<uint32_t> next_free;
+    uint32_t free_head;
+    uint32_t free_tail;
+    size_t live_count;
+
+    std::vector<std::unique_ptr<ComponentSetBase>> component_sets; // by component type
 };
 
 #endif
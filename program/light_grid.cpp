@@ -0,0 +1,80 @@
+#include "light_grid.h"
+
+#include <cmath>
+
+LightGrid::LightGrid() : width( 0 ), height( 0 ) {}
+
+void LightGrid::resize( const int width, const int height ) {
+    this->width = width;
+    this->height = height;
+    rebuild();
+}
+
+int LightGrid::add_light( const Light& light ) {
+    int id;
+    if ( !free_ids.empty() ) {
+        id = free_ids.back();
+        free_ids.pop_back();
+        lights[ id ] = light;
+        live[ id ] = true;
+    } else {
+        id = lights.size();
+        lights.push_back( light );
+        live.push_back( true );
+    }
+
+    apply( light, 1 );
+    return id;
+}
+
+void LightGrid::move_light( const int id, const float x, const float y ) {
+    Light& light = lights[ id ];
+    if ( light.x == x && light.y == y ) return;
+
+    // contributions are rounded to whole steps, so taking the old footprint
+    // back out leaves exactly what the other lights put there
+    apply( light, -1 );
+    light.x = x;
+    light.y = y;
+    apply( light, 1 );
+}
+
+void LightGrid::remove_light( const int id ) {
+    apply( lights[ id ], -1 );
+    live[ id ] = false;
+    free_ids.push_back( id );
+}
+
+size_t LightGrid::get_light_count() const {
+    return lights.size() - free_ids.size();
+}
+
+void LightGrid::rebuild() {
+    levels.assign( width * height, 0 );
+    for ( size_t i = 0; i < lights.size(); i++ ) {
+        if ( live[ i ] ) apply( lights[ i ], 1 );
+    }
+}
+
+void LightGrid::apply( const Light& light, const int sign ) {
+    const int min_x = std::max( 0, int(std::floor( light.x - light.radius )) );
+    const int max_x = std::min( width - 1, int(std::floor( light.x + light.radius )) );
+    const int min_y = std::max( 0, int(std::floor( light.y - light.radius )) );
+    const int max_y = std::min( height - 1, int(std::floor( light.y + light.radius )) );
+    const float inv_radius = 1 / light.radius;
+    const float scale = light.intensity * 255;
+
+    // falls off with squared distance so there's no square root per tile
+    for ( int y = min_y; y <= max_y; y++ ) {
+        const float dy = (y + .5f - light.y) * inv_radius;
+        int* row = &levels[ y * width ];
+
+        for ( int x = min_x; x <= max_x; x++ ) {
+            const float dx = (x + .5f - light.x) * inv_radius;
+            const float falloff = 1 - (dx * dx + dy * dy);
+            if ( falloff <= 0 ) continue;
+
+            row[ x ] += sign * int(scale * falloff * falloff + .5f);
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef LIGHT_GRID_H
+#define LIGHT_GRID_H
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "lighting.h"
+
+// light from moving sources summed per tile. moving a light only touches the
+// tiles inside its old and new radius, and reading a tile is a single lookup.
+// there's no shadowing here, dynamic lights are small enough to get away with it
+class LightGrid {
+public:
+    LightGrid();
+
+    void resize( const int width, const int height );
+
+    int add_light( const Light& light );
+    void move_light( const int id, const float x, const float y );
+    void remove_light( const int id );
+    size_t get_light_count() const;
+
+    // recomputes every tile from scratch
+    void rebuild();
+
+    // 0 - 255, how much dynamic light reaches a tile
+    inline uint8_t sample( const int cell ) const {
+        return std::min( levels[ cell ], 255 );
+    }
+
+private:
+    void apply( const Light& light, const int sign );
+
+    int width;
+    int height;
+    std::vector<int> levels; // summed contributions, 255 is fully lit
+    std::vector<Light> lights;
+    std::vector<uint8_t> live;
+    std::vector<int> free_ids;
+};
+
+#endif
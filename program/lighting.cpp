@@ -0,0 +1,124 @@
+#include "lighting.h"
+
+#include <cmath>
+#include <algorithm>
+
+// walks the grid cells the line passes through (amanatides & woo)
+bool line_of_sight( const std::vector<uint8_t>& solid, const int width, const int height,
+    const float x0, const float y0, const float x1, const float y1 ) {
+    int cell_x = x0;
+    int cell_y = y0;
+    const int end_x = x1;
+    const int end_y = y1;
+    const float dx = x1 - x0;
+    const float dy = y1 - y0;
+    const int step_x = dx > 0 ? 1 : -1;
+    const int step_y = dy > 0 ? 1 : -1;
+    const float delta_x = dx != 0 ? std::abs( 1 / dx ) : INFINITY;
+    const float delta_y = dy != 0 ? std::abs( 1 / dy ) : INFINITY;
+    float next_x = dx > 0 ? (cell_x + 1 - x0) * delta_x : (x0 - cell_x) * delta_x;
+    float next_y = dy > 0 ? (cell_y + 1 - y0) * delta_y : (y0 - cell_y) * delta_y;
+
+    while ( cell_x != end_x || cell_y != end_y ) {
+        if ( next_x < next_y ) {
+            if ( next_x > 1 ) break;
+            next_x += delta_x;
+            cell_x += step_x;
+        } else {
+            if ( next_y > 1 ) break;
+            next_y += delta_y;
+            cell_y += step_y;
+        }
+
+        if ( cell_x < 0 || cell_y < 0 || cell_x >= width || cell_y >= height ) return false;
+        if ( solid[ cell_x + cell_y * width ] ) return false;
+    }
+
+    return true;
+}
+
+Lightmap::Lightmap() {}
+
+void Lightmap::bake( const std::vector<uint8_t>& solid, const int width, const int height,
+    const std::vector<Light>& lights, WorkerPool& workers ) {
+    // outward normal of each face, in WallFace order
+    const int normal_x[ 4 ] = { -1, 1, 0, 0 };
+    const int normal_y[ 4 ] = { 0, 0, -1, 1 };
+
+    std::vector<int> wall_cells;
+    cell_slots.assign( width * height, -1 );
+    for ( int i = 0; i < width * height; i++ ) {
+        if ( !solid[ i ] ) continue;
+        cell_slots[ i ] = wall_cells.size() * 4 * LIGHTMAP_RESOLUTION;
+        wall_cells.push_back( i );
+    }
+
+    samples.assign( wall_cells.size() * 4 * LIGHTMAP_RESOLUTION, 0 );
+
+    // every wall cell only writes its own samples, so they can all go at once
+    workers.parallel_for( wall_cells.size(), [&]( const size_t begin, const size_t end ) {
+        for ( size_t c = begin; c < end; c++ ) {
+            const int cell = wall_cells[ c ];
+            const int cell_x = cell % width;
+            const int cell_y = cell / width;
+
+            for ( int face = 0; face < 4; face++ ) {
+                const int front_x = cell_x + normal_x[ face ];
+                const int front_y = cell_y + normal_y[ face ];
+                const bool exposed = front_x >= 0 && front_y >= 0 && front_x < width && front_y < height
+                    && !solid[ front_x + front_y * width ];
+                // nothing can light a buried face, but a ray clipping a corner
+                // might still land on one, so it gets the ambient level
+                if ( !exposed ) {
+                    const int slot = cell_slots[ cell ] + face * LIGHTMAP_RESOLUTION;
+                    std::fill( &samples[ slot ], &samples[ slot ] + LIGHTMAP_RESOLUTION, std::lround( LIGHT_AMBIENT * 255 ) );
+                    continue;
+                }
+
+                for ( int s = 0; s < LIGHTMAP_RESOLUTION; s++ ) {
+                    const float along = (s + .5f) / LIGHTMAP_RESOLUTION;
+
+                    // a point on the face, nudged out into the floor in front of it
+                    float px, py;
+                    if ( normal_x[ face ] != 0 ) {
+                        px = normal_x[ face ] < 0 ? cell_x - .001f : cell_x + 1.001f;
+                        py = cell_y + along;
+                    } else {
+                        px = cell_x + along;
+                        py = normal_y[ face ] < 0 ? cell_y - .001f : cell_y + 1.001f;
+                    }
+
+                    float level = LIGHT_AMBIENT;
+                    for ( auto& light : lights ) {
+                        const float to_x = light.x - px;
+                        const float to_y = light.y - py;
+                        const float dist = std::sqrt( to_x * to_x + to_y * to_y );
+                        if ( dist >= light.radius || dist == 0 ) continue;
+
+                        const float facing = (to_x * normal_x[ face ] + to_y * normal_y[ face ]) / dist;
+                        if ( facing <= 0 ) continue;
+                        if ( !line_of_sight( solid, width, height, light.x, light.y, px, py ) ) continue;
+
+                        const float falloff = 1 - dist / light.radius;
+                        level += light.intensity * facing * falloff * falloff;
+                    }
+
+                    const int slot = cell_slots[ cell ] + face * LIGHTMAP_RESOLUTION + s;
+                    samples[ slot ] = std::lround( std::min( level, 1.0f ) * 255 );
+                }
+            }
+        }
+    } );
+}
+
+bool Lightmap::is_baked() const {
+    return !samples.empty();
+}
+
+uint8_t Lightmap::sample( const int cell, const int face, const float along ) const {
+    const int slot = cell_slots[ cell ];
+    if ( slot < 0 ) return 255;
+
+    const int s = std::max( 0, std::min( int(along * LIGHTMAP_RESOLUTION), LIGHTMAP_RESOLUTION - 1 ) );
+    return samples[ slot + face * LIGHTMAP_RESOLUTION + s ];
+}
@@ -0,0 +1,41 @@
+#ifndef LIGHTING_H
+#define LIGHTING_H
+
+#include <vector>
+#include <cstdint>
+
+#include "worker_pool.h"
+
+#define LIGHTMAP_RESOLUTION 16 // samples along each wall face
+#define LIGHT_AMBIENT 0.3f     // how lit a face with no lights reaching it is
+
+struct Light {
+    float x;
+    float y;
+    float radius;
+    float intensity;
+};
+
+// whether anything solid sits on the straight line between two points
+bool line_of_sight( const std::vector<uint8_t>& solid, const int width, const int height,
+    const float x0, const float y0, const float x1, const float y1 );
+
+// light falling on every exposed face of every wall tile, baked once when the
+// map loads. faces are indexed west, east, north, south like WallFace
+class Lightmap {
+public:
+    Lightmap();
+
+    void bake( const std::vector<uint8_t>& solid, const int width, const int height,
+        const std::vector<Light>& lights, WorkerPool& workers );
+    bool is_baked() const;
+
+    // 0 - 255, along is how far across the face we are from 0 to 1
+    uint8_t sample( const int cell, const int face, const float along ) const;
+
+private:
+    std::vector<int> cell_slots; // where each wall cell's samples start, -1 for floor
+    std::vector<uint8_t> samples;
+};
+
+#endif
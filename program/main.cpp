@@ -7,6 +7,18 @@ sf::Texture render_texture;
 sf::Sprite render_sprite;
 sf::Clock delta_clock;
 Vec2 move_dir;
+uint8_t render_buffer[ FRAMEBUFFER_LENGTH * 4 ];
+std::vector<Rect> dirty_regions;
+CastMode cast_mode = CastEveryColumn;
+int shading_preset = 0;
+bool textured_floor = true;
+bool fog = false;
+bool lighting = true;
+bool palette_mode = false;
+bool sprites_front_to_back = false;
+bool sprite_cache = false;
+bool sprite_blending = false;
+int minimap_interval = 1;
 
 int main() {
     window = new sf::RenderWindow(
@@ -85,9 +97,13 @@ void draw() {
 
     engine.render();
 
-    uint8_t render_buffer[ FRAMEBUFFER_LENGTH * 4 ];
-    engine.get_framebuffer( render_buffer );
-    render_texture.update( render_buffer );
+    // only send what actually changed this frame over to the gpu
+    engine.get_dirty_framebuffer( render_buffer, dirty_regions );
+    size_t offset = 0;
+    for ( auto& r : dirty_regions ) {
+        render_texture.update( render_buffer + offset, r.w, r.h, r.x, r.y );
+        offset += r.w * r.h * 4;
+    }
     window->draw( render_sprite );
 
     window->display();
@@ -98,5 +114,72 @@ void handle_key_down( sf::Keyboard::Key key ) {
         case sf::Keyboard::Key::Escape:
             window->close();
             break;
+
+        case sf::Keyboard::Key::F1:
+            cast_mode = CastMode( (cast_mode + 1) % CAST_MODE_COUNT );
+            engine.set_cast_mode( cast_mode );
+            break;
+
+        case sf::Keyboard::Key::F2: {
+            // full density, then progressively coarser edges
+            const float centre_fractions[] = { 1.0f, 0.5f, 0.33f };
+            const int edge_rates[] = { 1, 2, 4 };
+            shading_preset = (shading_preset + 1) % 3;
+            engine.set_shading_rates( centre_fractions[ shading_preset ], edge_rates[ shading_preset ] );
+            break;
+        }
+
+        case sf::Keyboard::Key::F3:
+            textured_floor = !textured_floor;
+            if ( textured_floor ) engine.set_floor_textures( Wall1, Wall2 );
+            else engine.set_floor_textures( -1, -1 );
+            break;
+
+        case sf::Keyboard::Key::F4:
+            fog = !fog;
+            engine.set_fog( fog, Color( FOG_COLOR ), FOG_DENSITY );
+            break;
+
+        case sf::Keyboard::Key::F5:
+            lighting = !lighting;
+            engine.set_lighting_enabled( lighting );
+            break;
+
+        case sf::Keyboard::Key::F6:
+            palette_mode = !palette_mode;
+            engine.set_palette_mode( palette_mode );
+            break;
+
+        case sf::Keyboard::Key::F7:
+            sprites_front_to_back = !sprites_front_to_back;
+            engine.set_sprites_front_to_back( sprites_front_to_back );
+            break;
+
+        case sf::Keyboard::Key::F8:
+            sprite_cache = !sprite_cache;
+            engine.set_sprite_cache_enabled( sprite_cache );
+            break;
+
+        case sf::Keyboard::Key::F9:
+            sprite_blending = !sprite_blending;
+            engine.set_sprite_blending( sprite_blending );
+            break;
+
+        case sf::Keyboard::Key::F10: {
+            // a puff of dust a little way in front of the player
+            const Player player = engine.get_player();
+            engine.emit_particles( ParticleBurst {
+                player.position.x + std::cos( player.view_angle ) * 1.5f,
+                player.position.y + std::sin( player.view_angle ) * 1.5f,
+                0.3f, 1.0f, 2.0f, 0.02f, Color( 0xC8B496FF ), 2000
+            } );
+            break;
+        }
+
+        case sf::Keyboard::Key::F11:
+            // every frame, then every 2nd and every 4th
+            minimap_interval = minimap_interval >= 4 ? 1 : minimap_interval * 2;
+            engine.set_minimap_interval( minimap_interval );
+            break;
     }
 }
\ No newline at end of file
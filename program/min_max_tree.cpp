@@ -0,0 +1,39 @@
+#include "min_max_tree.h"
+
+#include <cmath>
+#include <algorithm>
+
+MinMaxTree::MinMaxTree() : leaves( 0 ) {}
+
+void MinMaxTree::build( const float* values, const size_t count ) {
+    leaves = 1;
+    while ( leaves < count ) leaves *= 2;
+
+    mins.assign( leaves * 2, INFINITY );
+    maxs.assign( leaves * 2, -INFINITY );
+    std::copy( values, values + count, mins.begin() + leaves );
+    std::copy( values, values + count, maxs.begin() + leaves );
+
+    for ( size_t i = leaves - 1; i > 0; i-- ) {
+        mins[ i ] = std::min( mins[ i * 2 ], mins[ i * 2 + 1 ] );
+        maxs[ i ] = std::max( maxs[ i * 2 ], maxs[ i * 2 + 1 ] );
+    }
+}
+
+void MinMaxTree::query( size_t begin, size_t end, float& min, float& max ) const {
+    min = INFINITY;
+    max = -INFINITY;
+
+    for ( begin += leaves, end += leaves; begin < end; begin /= 2, end /= 2 ) {
+        if ( begin & 1 ) {
+            min = std::min( min, mins[ begin ] );
+            max = std::max( max, maxs[ begin ] );
+            begin++;
+        }
+        if ( end & 1 ) {
+            end--;
+            min = std::min( min, mins[ end ] );
+            max = std::max( max, maxs[ end ] );
+        }
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef MIN_MAX_TREE_H
+#define MIN_MAX_TREE_H
+
+#include <vector>
+#include <cstddef>
+
+// smallest and largest value over any range of an array in log time. built
+// bottom up over a power of two number of leaves, padding doesn't affect
+// either answer
+class MinMaxTree {
+public:
+    MinMaxTree();
+
+    void build( const float* values, const size_t count );
+
+    // over [begin, end), which mustn't be empty
+    void query( size_t begin, size_t end, float& min, float& max ) const;
+
+private:
+    size_t leaves;
+    std::vector<float> mins;
+    std::vector<float> maxs;
+};
+
+#endif
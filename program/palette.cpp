@@ -0,0 +1,164 @@
+#include "palette.h"
+
+#include <cmath>
+
+Palette::Palette() : histogram( 1 << 15, 0 ), sums( 3 << 15, 0 ), inverse( 1 << 15, 0 ) {
+    colors.fill( Color( 0x000000FF ) );
+    std::memset( rgba, 0, sizeof( rgba ) );
+}
+
+void Palette::add_colors( const Color* colors, const size_t count ) {
+    // darker copies too, so there's something for the shaded colours to land on
+    const uint32_t weights[ 3 ] = { 4, 2, 1 };
+    const uint32_t scales[ 3 ] = { 256, 171, 85 };
+
+    for ( size_t i = 0; i < count; i++ ) {
+        uint8_t r, g, b, a;
+        colors[ i ].get_components( r, g, b, a );
+        if ( a < 0x80 ) continue;
+
+        for ( int s = 0; s < 3; s++ ) {
+            const uint32_t sr = (r * scales[ s ]) >> 8;
+            const uint32_t sg = (g * scales[ s ]) >> 8;
+            const uint32_t sb = (b * scales[ s ]) >> 8;
+            const uint32_t key = ((sr >> 3) << 10) | ((sg >> 3) << 5) | (sb >> 3);
+            histogram[ key ] += weights[ s ];
+            sums[ key * 3 ] += sr * weights[ s ];
+            sums[ key * 3 + 1 ] += sg * weights[ s ];
+            sums[ key * 3 + 2 ] += sb * weights[ s ];
+        }
+    }
+}
+
+void Palette::build( const std::vector<Color>& fixed ) {
+    colors[ PALETTE_TRANSPARENT ] = Color( 0x00000000 );
+    size_t used = 1;
+    for ( size_t i = 0; i < fixed.size() && used < PALETTE_SIZE; i++ ) colors[ used++ ] = fixed[ i ];
+
+    std::vector<uint16_t> keys;
+    for ( uint32_t key = 0; key < histogram.size(); key++ ) {
+        if ( histogram[ key ] ) keys.push_back( key );
+    }
+
+    // median cut: keep splitting the box with the most spread, weighted by how
+    // many pixels are in it, at the weighted median of its longest axis
+    struct Box {
+        size_t begin;
+        size_t end;
+    };
+    std::vector<Box> boxes;
+    if ( !keys.empty() ) boxes.push_back( Box { 0, keys.size() } );
+
+    auto channel = []( const uint16_t key, const int axis ) { return (key >> (10 - axis * 5)) & 0x1F; };
+    auto longest_axis = [&]( const Box& box, int& range ) {
+        int lo[ 3 ] = { 31, 31, 31 };
+        int hi[ 3 ] = { 0, 0, 0 };
+        for ( size_t i = box.begin; i < box.end; i++ ) {
+            for ( int axis = 0; axis < 3; axis++ ) {
+                lo[ axis ] = std::min( lo[ axis ], int(channel( keys[ i ], axis )) );
+                hi[ axis ] = std::max( hi[ axis ], int(channel( keys[ i ], axis )) );
+            }
+        }
+
+        int axis = 0;
+        for ( int a = 1; a < 3; a++ ) {
+            if ( hi[ a ] - lo[ a ] > hi[ axis ] - lo[ axis ] ) axis = a;
+        }
+        range = hi[ axis ] - lo[ axis ];
+        return axis;
+    };
+
+    while ( used + boxes.size() < PALETTE_SIZE ) {
+        int best = -1;
+        uint64_t best_score = 0;
+        for ( size_t b = 0; b < boxes.size(); b++ ) {
+            if ( boxes[ b ].end - boxes[ b ].begin < 2 ) continue;
+
+            int range;
+            longest_axis( boxes[ b ], range );
+            uint64_t count = 0;
+            for ( size_t i = boxes[ b ].begin; i < boxes[ b ].end; i++ ) count += histogram[ keys[ i ] ];
+
+            const uint64_t score = count * range;
+            if ( score > best_score ) {
+                best_score = score;
+                best = b;
+            }
+        }
+        if ( best < 0 ) break;
+
+        Box& box = boxes[ best ];
+        int range;
+        const int axis = longest_axis( box, range );
+        std::sort( keys.begin() + box.begin, keys.begin() + box.end, [&]( const uint16_t a, const uint16_t b ) {
+            return channel( a, axis ) < channel( b, axis );
+        } );
+
+        uint64_t total = 0;
+        for ( size_t i = box.begin; i < box.end; i++ ) total += histogram[ keys[ i ] ];
+
+        size_t split = box.begin + 1;
+        uint64_t running = histogram[ keys[ box.begin ] ];
+        while ( split < box.end - 1 && running * 2 < total ) running += histogram[ keys[ split++ ] ];
+
+        boxes.push_back( Box { split, box.end } );
+        boxes[ best ].end = split;
+    }
+
+    for ( auto& box : boxes ) {
+        uint64_t count = 0, r = 0, g = 0, b = 0;
+        for ( size_t i = box.begin; i < box.end; i++ ) {
+            count += histogram[ keys[ i ] ];
+            r += sums[ keys[ i ] * 3 ];
+            g += sums[ keys[ i ] * 3 + 1 ];
+            b += sums[ keys[ i ] * 3 + 2 ];
+        }
+        colors[ used++ ] = Color( r / count, g / count, b / count, 0xFF );
+    }
+
+    for ( size_t i = 0; i < PALETTE_SIZE; i++ ) {
+        colors[ i ].get_components( rgba[ i ][ 0 ], rgba[ i ][ 1 ], rgba[ i ][ 2 ], rgba[ i ][ 3 ] );
+    }
+
+    // nearest opaque entry for every 15 bit colour, measured from the middle
+    // of the cell
+    for ( uint32_t key = 0; key < inverse.size(); key++ ) {
+        const int r = ((key >> 10) & 0x1F) * 8 + 4;
+        const int g = ((key >> 5) & 0x1F) * 8 + 4;
+        const int b = (key & 0x1F) * 8 + 4;
+
+        int best = 1;
+        int best_dist = INT32_MAX;
+        for ( size_t i = 1; i < used; i++ ) {
+            const int dr = r - rgba[ i ][ 0 ];
+            const int dg = g - rgba[ i ][ 1 ];
+            const int db = b - rgba[ i ][ 2 ];
+            const int dist = dr * dr + dg * dg + db * db;
+            if ( dist < best_dist ) {
+                best_dist = dist;
+                best = i;
+            }
+        }
+        inverse[ key ] = best;
+    }
+
+    build_color_maps( nullptr );
+}
+
+void Palette::build_color_maps( const FogTable* fog ) {
+    color_maps.resize( PALETTE_FOG_LEVELS * PALETTE_LIGHT_LEVELS );
+
+    for ( int f = 0; f < PALETTE_FOG_LEVELS; f++ ) {
+        const float distance = (f + .5f) * (FOG_TABLE_RANGE / PALETTE_FOG_LEVELS);
+        const ShadeLevel fog_level = fog ? fog->lookup( distance ) : ShadeLevel { 256, 0, 0 };
+
+        for ( int l = 0; l < PALETTE_LIGHT_LEVELS; l++ ) {
+            ShadeLevel level = fog_level;
+            level.scale = (level.scale * (l * 256 / (PALETTE_LIGHT_LEVELS - 1))) >> 8;
+
+            ColorMap& map = color_maps[ f * PALETTE_LIGHT_LEVELS + l ];
+            map.index[ PALETTE_TRANSPARENT ] = PALETTE_TRANSPARENT;
+            for ( int i = 1; i < PALETTE_SIZE; i++ ) map.index[ i ] = nearest( shade_pixel( colors[ i ], level ) );
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+#include "color.h"
+#include "shading.h"
+
+#define PALETTE_SIZE 256
+#define PALETTE_TRANSPARENT 0 // index reserved for see-through sprite texels
+#define PALETTE_LIGHT_LEVELS 32
+#define PALETTE_FOG_LEVELS 32
+
+// palette index to palette index, for one amount of light and fog
+struct ColorMap {
+    uint8_t index[ PALETTE_SIZE ];
+};
+
+inline uint8_t shade_pixel( const uint8_t index, const ColorMap& map ) {
+    return map.index[ index ];
+}
+
+// 256 colours picked to suit the textures, for the 8 bit render mode. shading
+// in that mode is a lookup into a colour map instead of any arithmetic, and the
+// indices only get turned back into rgba when the frame is presented
+class Palette {
+public:
+    Palette();
+
+    // colours the palette gets built from, weighted by how often they turn up
+    void add_colors( const Color* colors, const size_t count );
+    // fixed colours each get an entry of their own, the rest are picked by
+    // median cut over everything added
+    void build( const std::vector<Color>& fixed );
+    // a null fog table means no fog
+    void build_color_maps( const FogTable* fog );
+
+    // closest entry, through a 15 bit rgb table
+    inline uint8_t nearest( const Color col ) const {
+        const uint32_t hex = col.get_hex();
+        return inverse[ ((hex >> 17) & 0x7C00) | ((hex >> 14) & 0x03E0) | ((hex >> 11) & 0x001F) ];
+    }
+
+    // light is 0 - 255
+    inline const ColorMap& get_color_map( const float distance, const int light ) const {
+        const int fog = std::max( 0, std::min( int(distance * (PALETTE_FOG_LEVELS / FOG_TABLE_RANGE)), PALETTE_FOG_LEVELS - 1 ) );
+        const int level = std::min( light, 255 ) * (PALETTE_LIGHT_LEVELS - 1) / 255;
+        return color_maps[ fog * PALETTE_LIGHT_LEVELS + level ];
+    }
+
+    // writes the rgba bytes of an entry
+    inline void expand( const uint8_t index, uint8_t* target ) const {
+        std::memcpy( target, rgba[ index ], 4 );
+    }
+
+private:
+    std::vector<uint32_t> histogram; // counts per 15 bit colour
+    std::vector<uint32_t> sums;      // r, g, b totals per 15 bit colour
+    std::array<Color, PALETTE_SIZE> colors;
+    uint8_t rgba[ PALETTE_SIZE ][ 4 ];
+    std::vector<uint8_t> inverse;
+    std::vector<ColorMap> color_maps; // light levels within fog levels
+};
+
+#endif
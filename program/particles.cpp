@@ -0,0 +1,252 @@
+#include "particles.h"
+
+#include <algorithm>
+
+#include "render_kernels.h"
+
+ParticleSystem::ParticleSystem() : seed( 0x9E3779B9 ) {}
+
+void ParticleSystem::emit( const ParticleBurst& burst ) {
+    for ( size_t i = 0; i < burst.count; i++ ) {
+        x.push_back( burst.x );
+        y.push_back( burst.y );
+        z.push_back( burst.z );
+        velocity_x.push_back( burst.speed * random_unit() );
+        velocity_y.push_back( burst.speed * random_unit() );
+        velocity_z.push_back( burst.speed * random_unit() );
+        life.push_back( burst.lifetime * (0.75f + 0.25f * random_unit()) );
+        size.push_back( burst.size );
+        color.push_back( burst.color );
+    }
+}
+
+void ParticleSystem::update( const float delta_time ) {
+    const size_t count = x.size();
+
+    // short branch free loops so they vectorise, with few enough arrays each
+    // that the compiler's overlap checks don't give up. anything that reaches
+    // the floor stops dead and stays there until it runs out of life
+    float* px = x.data();
+    float* py = y.data();
+    float* pz = z.data();
+    float* vx = velocity_x.data();
+    float* vy = velocity_y.data();
+    float* vz = velocity_z.data();
+    float* pl = life.data();
+    for ( size_t i = 0; i < count; i++ ) {
+        const float fall = vz[ i ] - PARTICLE_GRAVITY * delta_time;
+        const float height = pz[ i ] + fall * delta_time;
+        pz[ i ] = height > 0 ? height : 0.0f;
+        vz[ i ] = height > 0 ? fall : 0.0f;
+    }
+    for ( size_t i = 0; i < count; i++ ) {
+        const float moving = pz[ i ] > 0 ? delta_time : 0.0f;
+        px[ i ] += vx[ i ] * moving;
+        py[ i ] += vy[ i ] * moving;
+    }
+    for ( size_t i = 0; i < count; i++ ) pl[ i ] -= delta_time;
+
+    for ( size_t i = 0; i < x.size(); ) {
+        if ( life[ i ] > 0 ) {
+            i++;
+            continue;
+        }
+
+        x[ i ] = x.back();
+        y[ i ] = y.back();
+        z[ i ] = z.back();
+        velocity_x[ i ] = velocity_x.back();
+        velocity_y[ i ] = velocity_y.back();
+        velocity_z[ i ] = velocity_z.back();
+        life[ i ] = life.back();
+        size[ i ] = size.back();
+        color[ i ] = color.back();
+
+        x.pop_back();
+        y.pop_back();
+        z.pop_back();
+        velocity_x.pop_back();
+        velocity_y.pop_back();
+        velocity_z.pop_back();
+        life.pop_back();
+        size.pop_back();
+        color.pop_back();
+    }
+}
+
+void ParticleSystem::clear() {
+    x.clear();
+    y.clear();
+    z.clear();
+    velocity_x.clear();
+    velocity_y.clear();
+    velocity_z.clear();
+    life.clear();
+    size.clear();
+    color.clear();
+}
+
+size_t ParticleSystem::get_count() const {
+    return x.size();
+}
+
+const float* ParticleSystem::get_x() const {
+    return x.data();
+}
+
+const float* ParticleSystem::get_y() const {
+    return y.data();
+}
+
+const float* ParticleSystem::get_z() const {
+    return z.data();
+}
+
+const float* ParticleSystem::get_size() const {
+    return size.data();
+}
+
+const Color* ParticleSystem::get_color() const {
+    return color.data();
+}
+
+// xorshift, plenty for scattering particles about
+float ParticleSystem::random_unit() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return (seed >> 8) * (2.0f / (1 << 24)) - 1;
+}
+
+ParticleBatch::ParticleBatch() : view_width( 0 ), drawn( 0 ), bounds( Rect { 0, 0, 0, 0 } ) {}
+
+void ParticleBatch::build( const ParticleSystem& particles, const ParticleView& view,
+    const FogTable* fog, const Palette* palette, WorkerPool& workers ) {
+    const size_t count = particles.get_count();
+    view_width = view.width;
+    depth.resize( count );
+    distance.resize( count );
+    screen_x.resize( count );
+    left.resize( count );
+    right.resize( count );
+    top.resize( count );
+    bottom.resize( count );
+    colors.resize( count );
+    indices.resize( palette ? count : 0 );
+
+    const float* xs = particles.get_x();
+    const float* ys = particles.get_y();
+    const float* zs = particles.get_z();
+    const float* sizes = particles.get_size();
+    const Color* source_colors = particles.get_color();
+
+    workers.parallel_for( count, [&]( const size_t begin, const size_t end ) {
+        project_sprite_batch( end - begin, xs + begin, ys + begin,
+            view.camera_x, view.camera_y, view.cos_angle, view.sin_angle,
+            view.columns_per_radian, view.centre_column,
+            &depth[ begin ], &distance[ begin ], &screen_x[ begin ] );
+
+        for ( size_t i = begin; i < end; i++ ) {
+            left[ i ] = right[ i ] = 0;
+            if ( depth[ i ] <= 0 ) continue; // behind the camera
+
+            // sized and placed the way sprites are, one world unit is
+            // height / distance pixels
+            const float scale = view.height / distance[ i ];
+            const int pixels = std::max( 1, std::min( PARTICLE_MAX_PIXELS, int(sizes[ i ] * scale) ) );
+            const int centre_x = int(screen_x[ i ]);
+            const int centre_y = int(view.height / 2 + (0.5f - zs[ i ]) * scale);
+
+            const int x0 = std::max( 0, centre_x - pixels / 2 );
+            const int x1 = std::min( view.width, centre_x - pixels / 2 + pixels );
+            const int y0 = std::max( 0, centre_y - pixels / 2 );
+            const int y1 = std::min( view.height, centre_y - pixels / 2 + pixels );
+            if ( x0 >= x1 || y0 >= y1 ) continue;
+
+            left[ i ] = x0;
+            right[ i ] = x1;
+            top[ i ] = y0;
+            bottom[ i ] = y1;
+            colors[ i ] = fog ? shade_pixel( source_colors[ i ], fog->lookup( distance[ i ] ) ) : source_colors[ i ];
+            if ( palette ) indices[ i ] = palette->nearest( colors[ i ] );
+        }
+    } );
+
+    // counting sort into tiles, which keeps each tile's particles in index
+    // order. nothing is wider than a tile, so a particle lands in two at most
+    const size_t tile_count = (view.width + PARTICLE_TILE_WIDTH - 1) / PARTICLE_TILE_WIDTH;
+    tile_offsets.assign( tile_count + 1, 0 );
+    drawn = 0;
+    int x0 = view.width, y0 = view.height, x1 = 0, y1 = 0;
+    for ( size_t i = 0; i < count; i++ ) {
+        if ( left[ i ] >= right[ i ] ) continue;
+
+        drawn++;
+        x0 = std::min( x0, int(left[ i ]) );
+        x1 = std::max( x1, int(right[ i ]) );
+        y0 = std::min( y0, int(top[ i ]) );
+        y1 = std::max( y1, int(bottom[ i ]) );
+        tile_offsets[ left[ i ] / PARTICLE_TILE_WIDTH + 1 ]++;
+        if ( (right[ i ] - 1) / PARTICLE_TILE_WIDTH != left[ i ] / PARTICLE_TILE_WIDTH ) {
+            tile_offsets[ (right[ i ] - 1) / PARTICLE_TILE_WIDTH + 1 ]++;
+        }
+    }
+    bounds = drawn ? Rect { x0, y0, x1 - x0, y1 - y0 } : Rect { 0, 0, 0, 0 };
+
+    for ( size_t t = 0; t < tile_count; t++ ) tile_offsets[ t + 1 ] += tile_offsets[ t ];
+    tile_items.resize( tile_offsets[ tile_count ] );
+
+    std::vector<uint32_t> cursor( tile_offsets.begin(), tile_offsets.end() - 1 );
+    for ( size_t i = 0; i < count; i++ ) {
+        if ( left[ i ] >= right[ i ] ) continue;
+
+        const int first_tile = left[ i ] / PARTICLE_TILE_WIDTH;
+        const int last_tile = (right[ i ] - 1) / PARTICLE_TILE_WIDTH;
+        tile_items[ cursor[ first_tile ]++ ] = i;
+        if ( last_tile != first_tile ) tile_items[ cursor[ last_tile ]++ ] = i;
+    }
+}
+
+void ParticleBatch::draw( Color* target, const int stride, const float* wall_depth, WorkerPool& workers ) const {
+    draw_tiles( target, stride, wall_depth, colors.data(), workers );
+}
+
+void ParticleBatch::draw( uint8_t* target, const int stride, const float* wall_depth, WorkerPool& workers ) const {
+    draw_tiles( target, stride, wall_depth, indices.data(), workers );
+}
+
+size_t ParticleBatch::get_drawn_count() const {
+    return drawn;
+}
+
+Rect ParticleBatch::get_bounds() const {
+    return bounds;
+}
+
+template <typename Pixel>
+void ParticleBatch::draw_tiles( Pixel* target, const int stride, const float* wall_depth, const Pixel* pixels,
+    WorkerPool& workers ) const {
+    const size_t tile_count = tile_offsets.size() - 1;
+
+    workers.parallel_for( tile_count, [&]( const size_t begin, const size_t end ) {
+        for ( size_t t = begin; t < end; t++ ) {
+            const int first_column = t * PARTICLE_TILE_WIDTH;
+            const int last_column = std::min( first_column + PARTICLE_TILE_WIDTH, view_width );
+
+            for ( size_t k = tile_offsets[ t ]; k < tile_offsets[ t + 1 ]; k++ ) {
+                const uint32_t i = tile_items[ k ];
+                const int x0 = std::max( int(left[ i ]), first_column );
+                const int x1 = std::min( int(right[ i ]), last_column );
+                const Pixel pixel = pixels[ i ];
+
+                for ( int x = x0; x < x1; x++ ) {
+                    // the walls' distances are perpendicular, so measure along the view too
+                    if ( wall_depth[ x ] < depth[ i ] ) continue; // behind a wall
+
+                    Pixel* row = target + top[ i ] * stride + x;
+                    for ( int y = top[ i ]; y < bottom[ i ]; y++, row += stride ) *row = pixel;
+                }
+            }
+        }
+    } );
+}
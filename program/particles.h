@@ -0,0 +1,119 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "color.h"
+#include "rect.h"
+#include "shading.h"
+#include "palette.h"
+#include "worker_pool.h"
+
+#define PARTICLE_GRAVITY 2.5f   // floor to ceiling heights per second, per second
+#define PARTICLE_MAX_PIXELS 8   // widest a particle gets drawn, however close it is
+#define PARTICLE_TILE_WIDTH 16  // columns per tile when drawing
+
+// a handful of particles thrown out from one spot, like a muzzle flash, a
+// splash of blood or a puff of dust
+struct ParticleBurst {
+    float x;
+    float y;
+    float z;        // height off the floor, 1 is the ceiling
+    float speed;    // the fastest any of them leave, in any direction
+    float lifetime; // seconds, each one gets somewhere between half and all of it
+    float size;     // world units across
+    Color color;
+    size_t count;
+};
+
+// every live particle, one array per field so the update is a few straight
+// loops the compiler can vectorise. dead particles are swapped out with the
+// last live one, so the arrays stay packed
+class ParticleSystem {
+public:
+    ParticleSystem();
+
+    void emit( const ParticleBurst& burst );
+    void update( const float delta_time );
+    void clear();
+
+    size_t get_count() const;
+    const float* get_x() const;
+    const float* get_y() const;
+    const float* get_z() const;
+    const float* get_size() const;
+    const Color* get_color() const;
+
+private:
+    float random_unit(); // -1 - 1
+
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> velocity_x;
+    std::vector<float> velocity_y;
+    std::vector<float> velocity_z;
+    std::vector<float> life; // seconds left
+    std::vector<float> size;
+    std::vector<Color> color;
+    uint32_t seed;
+};
+
+// where the camera is and how the view is laid out, the same numbers the
+// sprite pass projects with
+struct ParticleView {
+    float camera_x;
+    float camera_y;
+    float cos_angle;
+    float sin_angle;
+    float columns_per_radian;
+    float centre_column;
+    int width;
+    int height;
+};
+
+// one frame's particles in screen space, binned by the column tiles they
+// overlap so the tiles can be drawn on different threads. particles are small
+// enough to skip sorting: each is tested against the walls' depth per column
+// and drawn in a fixed order, so the result doesn't depend on the threads
+class ParticleBatch {
+public:
+    ParticleBatch();
+
+    // a null fog draws colours as they are, a null palette skips working out
+    // the palette index of each particle
+    void build( const ParticleSystem& particles, const ParticleView& view,
+        const FogTable* fog, const Palette* palette, WorkerPool& workers );
+
+    // target is the top left of the 3d view, wall_depth the perpendicular
+    // wall distance of each of its columns
+    void draw( Color* target, const int stride, const float* wall_depth, WorkerPool& workers ) const;
+    void draw( uint8_t* target, const int stride, const float* wall_depth, WorkerPool& workers ) const;
+
+    size_t get_drawn_count() const;
+    // screen area covered by everything drawn, relative to the 3d view
+    Rect get_bounds() const;
+
+private:
+    template <typename Pixel>
+    void draw_tiles( Pixel* target, const int stride, const float* wall_depth, const Pixel* pixels, WorkerPool& workers ) const;
+
+    int view_width;
+    std::vector<float> depth;
+    std::vector<float> distance;
+    std::vector<float> screen_x;
+    std::vector<int16_t> left; // clipped to the view, right and bottom exclusive
+    std::vector<int16_t> right;
+    std::vector<int16_t> top;
+    std::vector<int16_t> bottom;
+    std::vector<Color> colors;
+    std::vector<uint8_t> indices;
+    std::vector<uint32_t> tile_offsets; // first entry of each tile in tile_items, plus one past the end
+    std::vector<uint32_t> tile_items;
+    size_t drawn;
+    Rect bounds;
+};
+
+#endif
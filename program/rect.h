@@ -0,0 +1,31 @@
+#ifndef RECT_H
+#define RECT_H
+
+#include <algorithm>
+
+struct Rect {
+    int x;
+    int y;
+    int w;
+    int h;
+
+    bool empty() const {
+        return w <= 0 || h <= 0;
+    }
+
+    bool contains( const Rect& other ) const {
+        return other.x >= x && other.y >= y &&
+            other.x + other.w <= x + w &&
+            other.y + other.h <= y + h;
+    }
+
+    Rect clipped( const Rect& bounds ) const {
+        const int x0 = std::max( x, bounds.x );
+        const int y0 = std::max( y, bounds.y );
+        const int x1 = std::min( x + w, bounds.x + bounds.w );
+        const int y1 = std::min( y + h, bounds.y + bounds.h );
+        return Rect { x0, y0, x1 - x0, y1 - y0 };
+    }
+};
+
+#endif
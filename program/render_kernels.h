@@ -0,0 +1,405 @@
+#ifndef RENDER_KERNELS_H
+#define RENDER_KERNELS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <cmath>
+
+#include "color.h"
+#include "shading.h"
+#include "palette.h"
+#include "texture.h"
+
+// inner loops of the column renderer, specialised at compile time on the view
+// height (0 = take it at runtime) and on log2 of the texture size (0 = not a
+// power of two) so the common cases get constant bounds, shifts and masks.
+// texels are always a single contiguous texture column. a null shade level
+// means draw the texels as they are.
+//
+// each kernel comes in two pixel formats: full Colors shaded by a ShadeLevel,
+// and 8 bit palette indices shaded through a ColorMap
+
+template <typename Pixel, typename Shade>
+using WallColumnKernelOf = void (*)( Pixel* target, const int stride, const int width,
+    const Pixel* texels, const size_t tex_size, const int column_height,
+    const int view_height, const Pixel clear_color, const bool clear,
+    const Shade* shade );
+
+template <typename Pixel, typename Shade>
+using SpriteColumnKernelOf = void (*)( Pixel* target, const int stride,
+    const Pixel* texels, const TexelSpan* spans, const size_t span_count,
+    const size_t tex_size, const int sprite_size,
+    const int v_offset, const int view_height, const Shade* shade, uint64_t* coverage );
+
+typedef WallColumnKernelOf<Color, ShadeLevel> WallColumnKernel;
+typedef WallColumnKernelOf<uint8_t, ColorMap> IndexedWallColumnKernel;
+typedef SpriteColumnKernelOf<Color, ShadeLevel> SpriteColumnKernel;
+typedef SpriteColumnKernelOf<uint8_t, ColorMap> IndexedSpriteColumnKernel;
+
+// translucent sprite texels only make sense in full colour
+typedef void (*SpriteBlendKernel)( Color* target, const int stride,
+    const Color* texels, const TexelSpan* spans, const size_t span_count,
+    const size_t tex_size, const int sprite_size,
+    const int v_offset, const int view_height, const ShadeLevel& shade );
+
+// rows of a column a blended sprite gathers up before blending them together
+#define BLEND_BATCH 64
+
+
+// 32.32 fixed point step through a texture of tex_size texels over count
+// pixels. rounded up so that (i * step) >> 32 lands on exactly the same texel
+// as (i * tex_size) / count for any count we can draw
+template <int TexShift>
+inline uint64_t texel_step( const size_t tex_size, const int count ) {
+    const uint64_t size = TexShift ? uint64_t(1) << TexShift : tex_size;
+    return ((size << 32) + count - 1) / count;
+}
+
+template <int TexShift>
+inline size_t texel_index( const uint64_t position, const size_t tex_size ) {
+    if ( TexShift ) return (position >> 32) & ((size_t(1) << TexShift) - 1);
+    return std::min( size_t(position >> 32), tex_size - 1 );
+}
+
+// a full column of the 3d view: flat colour, wall, flat colour. drawn width
+// pixels wide. without clear only the wall gets drawn
+template <int Height, int TexShift, typename Pixel, typename Shade>
+void wall_column_kernel( Pixel* target, const int stride, const int width,
+    const Pixel* texels, const size_t tex_size, const int column_height,
+    const int view_height, const Pixel clear_color, const bool clear,
+    const Shade* shade ) {
+    const int height = Height ? Height : view_height;
+    const int top = height / 2 - column_height / 2;
+    const int start = std::max( 0, top );
+    const int end = std::max( start, std::min( height, top + column_height ) );
+    const uint64_t step = texel_step<TexShift>( tex_size, column_height );
+
+    Pixel* row = target;
+    if ( !clear ) row += start * stride;
+    for ( int y = 0; clear && y < start; y++, row += stride ) {
+        for ( int x = 0; x < width; x++ ) row[ x ] = clear_color;
+    }
+
+    uint64_t position = step * uint64_t(start - top);
+    for ( int y = start; y < end; y++, row += stride, position += step ) {
+        Pixel col = texels[ texel_index<TexShift>( position, tex_size ) ];
+        if ( shade ) col = shade_pixel( col, *shade );
+        for ( int x = 0; x < width; x++ ) row[ x ] = col;
+    }
+
+    for ( int y = end; clear && y < height; y++, row += stride ) {
+        for ( int x = 0; x < width; x++ ) row[ x ] = clear_color;
+    }
+}
+
+template <typename Pixel, typename Shade>
+using FloorRowKernelOf = void (*)( Pixel* floor_row, Pixel* ceiling_row, const int width,
+    const float base_x, const float base_y, const float step_x, const float step_y,
+    const float* column_tans, const int* floor_start, const int* ceiling_end,
+    const int floor_y, const int ceiling_y,
+    const Pixel* floor_texels, const Pixel* ceiling_texels, const size_t tex_size,
+    const Shade* shade, uint32_t* offsets );
+
+typedef FloorRowKernelOf<Color, ShadeLevel> FloorRowKernel;
+typedef FloorRowKernelOf<uint8_t, ColorMap> IndexedFloorRowKernel;
+
+// one row of floor and the ceiling row mirrored above it, which sits at the
+// same distance. the world position under column i is base + step * tan_i, so
+// all the texel offsets for the row get worked out in one straight loop the
+// compiler can vectorise, then the texels are fetched wherever no wall covers
+// the row. floor_start is the first floor row of each column and ceiling_end
+// one past the last ceiling row
+template <int TexShift, typename Pixel, typename Shade>
+void floor_row_kernel( Pixel* floor_row, Pixel* ceiling_row, const int width,
+    const float base_x, const float base_y, const float step_x, const float step_y,
+    const float* column_tans, const int* floor_start, const int* ceiling_end,
+    const int floor_y, const int ceiling_y,
+    const Pixel* floor_texels, const Pixel* ceiling_texels, const size_t tex_size,
+    const Shade* shade, uint32_t* offsets ) {
+    const int size = TexShift ? 1 << TexShift : tex_size;
+    const float scale = size;
+
+    for ( int i = 0; i < width; i++ ) {
+        const int u = int( (base_x + step_x * column_tans[ i ]) * scale );
+        const int v = int( (base_y + step_y * column_tans[ i ]) * scale );
+        if ( TexShift ) {
+            offsets[ i ] = ((u & (size - 1)) << TexShift) | (v & (size - 1));
+        } else {
+            offsets[ i ] = ((u % size + size) % size) * size + (v % size + size) % size;
+        }
+    }
+
+    if ( shade ) {
+        const Shade level = *shade;
+        for ( int i = 0; i < width; i++ ) {
+            if ( floor_y >= floor_start[ i ] ) floor_row[ i ] = shade_pixel( floor_texels[ offsets[ i ] ], level );
+            if ( ceiling_y < ceiling_end[ i ] ) ceiling_row[ i ] = shade_pixel( ceiling_texels[ offsets[ i ] ], level );
+        }
+        return;
+    }
+
+    for ( int i = 0; i < width; i++ ) {
+        if ( floor_y >= floor_start[ i ] ) floor_row[ i ] = floor_texels[ offsets[ i ] ];
+        if ( ceiling_y < ceiling_end[ i ] ) ceiling_row[ i ] = ceiling_texels[ offsets[ i ] ];
+    }
+}
+
+// first screen row of a scaled column that lands on texel t or past it
+inline int first_row_at_texel( const size_t t, const uint64_t step ) {
+    return ((uint64_t(t) << 32) + step - 1) / step;
+}
+
+// whether every row in [begin, end) of a column's coverage bits is set
+inline bool rows_covered( const uint64_t* coverage, const int begin, const int end ) {
+    for ( int y = begin; y < end; ) {
+        const int bit = y & 63;
+        const int count = std::min( 64 - bit, end - y );
+        const uint64_t want = (count == 64 ? ~uint64_t(0) : ((uint64_t(1) << count) - 1)) << bit;
+        if ( (coverage[ y >> 6 ] & want) != want ) return false;
+        y += count;
+    }
+    return true;
+}
+
+// calls draw( y ) for every row in [begin, end) whose coverage bit isn't set
+// yet, and sets them all. goes a word of rows at a time and only visits the
+// free ones
+template <typename Draw>
+inline void draw_uncovered_rows( uint64_t* coverage, const int begin, const int end, Draw draw ) {
+    for ( int y = begin; y < end; ) {
+        const int bit = y & 63;
+        const int count = std::min( 64 - bit, end - y );
+        const uint64_t rows = (count == 64 ? ~uint64_t(0) : ((uint64_t(1) << count) - 1)) << bit;
+        uint64_t free = rows & ~coverage[ y >> 6 ];
+        coverage[ y >> 6 ] |= rows;
+
+        while ( free ) {
+            draw( y - bit + __builtin_ctzll( free ) );
+            free &= free - 1;
+        }
+        y += count;
+    }
+}
+
+// one screen column of a sprite. target is the top of the framebuffer column,
+// v_offset where the sprite starts within it. only the texture column's opaque
+// spans get drawn, each scaled to the rows it covers, so transparent texels are
+// never read or tested.
+//
+// with coverage (one bit per row of the column) sprites can be drawn front to
+// back: rows something nearer already drew are skipped and the rest marked
+template <int TexShift, typename Pixel, typename Shade>
+void sprite_column_kernel( Pixel* target, const int stride,
+    const Pixel* texels, const TexelSpan* spans, const size_t span_count,
+    const size_t tex_size, const int sprite_size,
+    const int v_offset, const int view_height, const Shade* shade, uint64_t* coverage ) {
+    const int first = std::max( 0, -v_offset );
+    const int last = std::min( sprite_size, view_height - v_offset );
+    const uint64_t step = texel_step<TexShift>( tex_size, sprite_size );
+
+    for ( size_t s = 0; s < span_count; s++ ) {
+        const int begin = std::max( first, first_row_at_texel( spans[ s ].start, step ) );
+        const int end = std::min( last, first_row_at_texel( spans[ s ].end, step ) );
+
+        uint64_t position = step * uint64_t(begin);
+        Pixel* pixel = target + (v_offset + begin) * stride;
+        if ( coverage ) {
+            draw_uncovered_rows( coverage, v_offset + begin, v_offset + end, [&]( const int y ) {
+                const Pixel col = texels[ texel_index<TexShift>( step * uint64_t(y - v_offset), tex_size ) ];
+                target[ y * stride ] = shade ? shade_pixel( col, *shade ) : col;
+            } );
+            continue;
+        }
+
+        for ( int j = begin; j < end; j++, pixel += stride, position += step ) {
+            const Pixel col = texels[ texel_index<TexShift>( position, tex_size ) ];
+            *pixel = shade ? shade_pixel( col, *shade ) : col;
+        }
+    }
+}
+
+// a premultiplied texel over what's already there. the texel is shaded first,
+// with the fog it picks up scaled by its own alpha so that see-through edges
+// don't turn into fog. two channels per multiply like shade_pixel, and the
+// divides by 255 are done as (x + 128 + (x >> 8)) >> 8
+inline uint32_t blend_pixel( const uint32_t src, const uint32_t dst, const ShadeLevel& level ) {
+    const uint32_t alpha = src & 0xFF;
+    const uint32_t inverse = 255 - alpha;
+
+    const uint32_t src_rb = ((((src >> 8) & 0x00FF00FF) * level.scale
+        + ((level.add_rb >> 8) & 0x00FF00FF) * alpha) >> 8) & 0x00FF00FF;
+    const uint32_t src_g = (((src >> 16) & 0xFF) * level.scale + ((level.add_g >> 24) & 0xFF) * alpha) >> 8;
+
+    uint32_t dst_rb = ((dst >> 8) & 0x00FF00FF) * inverse;
+    dst_rb = ((dst_rb + 0x00800080 + ((dst_rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+    uint32_t dst_g = ((dst >> 16) & 0xFF) * inverse;
+    dst_g = (dst_g + 128 + (dst_g >> 8)) >> 8;
+
+    return ((src_rb + dst_rb) << 8) | ((src_g + dst_g) << 16) | (dst & 0xFF);
+}
+
+// the partly see-through runs of a sprite column, blended over the frame.
+// texels are premultiplied by their alpha. these runs are only ever a few
+// rows long, so the rows of every span get gathered up first and then blended
+// in one straight loop the compiler can vectorise
+template <int TexShift>
+void sprite_blend_column_kernel( Color* target, const int stride,
+    const Color* texels, const TexelSpan* spans, const size_t span_count,
+    const size_t tex_size, const int sprite_size,
+    const int v_offset, const int view_height, const ShadeLevel& shade ) {
+    const int first = std::max( 0, -v_offset );
+    const int last = std::min( sprite_size, view_height - v_offset );
+    const uint64_t step = texel_step<TexShift>( tex_size, sprite_size );
+
+    uint32_t src[ BLEND_BATCH ];
+    uint32_t dst[ BLEND_BATCH ];
+    Color* pixels[ BLEND_BATCH ];
+    int pending = 0;
+
+    const auto flush = [&]() {
+        for ( int k = 0; k < pending; k++ ) dst[ k ] = blend_pixel( src[ k ], dst[ k ], shade );
+        for ( int k = 0; k < pending; k++ ) *pixels[ k ] = Color( dst[ k ] );
+        pending = 0;
+    };
+
+    for ( size_t s = 0; s < span_count; s++ ) {
+        const int begin = std::max( first, first_row_at_texel( spans[ s ].start, step ) );
+        const int end = std::min( last, first_row_at_texel( spans[ s ].end, step ) );
+
+        for ( int j = begin; j < end; j++ ) {
+            pixels[ pending ] = target + (v_offset + j) * stride;
+            src[ pending ] = texels[ texel_index<TexShift>( step * uint64_t(j), tex_size ) ].get_hex();
+            dst[ pending ] = pixels[ pending ]->get_hex();
+            if ( ++pending == BLEND_BATCH ) flush();
+        }
+    }
+    flush();
+}
+
+// one screen column of a sprite from the sprite cache. the spans are already
+// in sprite rows with their pixels packed one after another, so apart from the
+// shading this is a straight copy
+template <typename Pixel, typename Shade>
+void scaled_sprite_column_kernel( Pixel* target, const int stride,
+    const Pixel* pixels, const TexelSpan* spans, const size_t span_count,
+    const int v_offset, const int view_height, const Shade* shade, uint64_t* coverage ) {
+    for ( size_t s = 0; s < span_count; s++ ) {
+        const int start = spans[ s ].start;
+        const Pixel* run = pixels;
+        pixels += spans[ s ].end - start;
+
+        const int begin = std::max( start, -v_offset );
+        const int end = std::min( int(spans[ s ].end), view_height - v_offset );
+        if ( begin >= end ) continue;
+
+        if ( coverage ) {
+            draw_uncovered_rows( coverage, v_offset + begin, v_offset + end, [&]( const int y ) {
+                const Pixel col = run[ y - v_offset - start ];
+                target[ y * stride ] = shade ? shade_pixel( col, *shade ) : col;
+            } );
+            continue;
+        }
+
+        Pixel* pixel = target + (v_offset + begin) * stride;
+        if ( shade ) {
+            const Shade level = *shade;
+            for ( int j = begin; j < end; j++, pixel += stride ) *pixel = shade_pixel( run[ j - start ], level );
+        } else {
+            for ( int j = begin; j < end; j++, pixel += stride ) *pixel = run[ j - start ];
+        }
+    }
+}
+
+// arctangent to within about 1e-5 radians, with no branches or library calls
+// so a loop of them vectorises. folds |t| > 1 onto 1 / |t| and uses an odd
+// polynomial over [0, 1]. the batch loop below also needs -fno-math-errno for
+// its square root
+inline float fast_atan( const float t ) {
+    const float a = std::abs( t );
+    const float x = std::min( a, 1 / a );
+    const float x2 = x * x;
+    const float r = x * (0.99997726f + x2 * (-0.33262347f + x2 * (0.19354346f
+        + x2 * (-0.11643287f + x2 * (0.05265332f + x2 * -0.01172120f)))));
+
+    // blended rather than picked, the compiler won't vectorise the select
+    const float big = a > 1;
+    return std::copysign( r + big * (float(M_PI / 2) - 2 * r), t );
+}
+
+// moves count world positions into camera space in one go: depth along the
+// view direction (<= 0 is behind the camera), straight line distance, and the
+// screen column the centre lands on. columns are spaced evenly in angle like
+// the cast pass' rays, columns_per_radian apart, with the view centre at
+// centre_column
+inline void project_sprite_batch( const size_t count, const float* world_x, const float* world_y,
+    const float camera_x, const float camera_y, const float cos_angle, const float sin_angle,
+    const float columns_per_radian, const float centre_column,
+    float* depth, float* distance, float* screen_x ) {
+    for ( size_t i = 0; i < count; i++ ) {
+        const float dx = world_x[ i ] - camera_x;
+        const float dy = world_y[ i ] - camera_y;
+        const float forward = dx * cos_angle + dy * sin_angle;
+        const float side = dy * cos_angle - dx * sin_angle;
+
+        depth[ i ] = forward;
+        distance[ i ] = std::sqrt( dx * dx + dy * dy );
+        screen_x[ i ] = fast_atan( side / forward ) * columns_per_radian + centre_column;
+    }
+}
+
+// resolutions worth a specialisation of their own, anything else passes its
+// height in at runtime
+constexpr bool is_common_height( const int height ) {
+    return height == 360 || height == 480 || height == 512 || height == 720 || height == 1080;
+}
+
+template <int Height, typename Pixel = Color, typename Shade = ShadeLevel>
+WallColumnKernelOf<Pixel, Shade> pick_wall_column_kernel( const size_t tex_size ) {
+    constexpr int H = is_common_height( Height ) ? Height : 0;
+    switch ( tex_size ) {
+        case 16: return wall_column_kernel<H, 4, Pixel, Shade>;
+        case 32: return wall_column_kernel<H, 5, Pixel, Shade>;
+        case 64: return wall_column_kernel<H, 6, Pixel, Shade>;
+        case 128: return wall_column_kernel<H, 7, Pixel, Shade>;
+        case 256: return wall_column_kernel<H, 8, Pixel, Shade>;
+        default: return wall_column_kernel<H, 0, Pixel, Shade>;
+    }
+}
+
+template <typename Pixel = Color, typename Shade = ShadeLevel>
+FloorRowKernelOf<Pixel, Shade> pick_floor_row_kernel( const size_t tex_size ) {
+    switch ( tex_size ) {
+        case 16: return floor_row_kernel<4, Pixel, Shade>;
+        case 32: return floor_row_kernel<5, Pixel, Shade>;
+        case 64: return floor_row_kernel<6, Pixel, Shade>;
+        case 128: return floor_row_kernel<7, Pixel, Shade>;
+        case 256: return floor_row_kernel<8, Pixel, Shade>;
+        default: return floor_row_kernel<0, Pixel, Shade>;
+    }
+}
+
+template <typename Pixel = Color, typename Shade = ShadeLevel>
+SpriteColumnKernelOf<Pixel, Shade> pick_sprite_column_kernel( const size_t tex_size ) {
+    switch ( tex_size ) {
+        case 16: return sprite_column_kernel<4, Pixel, Shade>;
+        case 32: return sprite_column_kernel<5, Pixel, Shade>;
+        case 64: return sprite_column_kernel<6, Pixel, Shade>;
+        case 128: return sprite_column_kernel<7, Pixel, Shade>;
+        case 256: return sprite_column_kernel<8, Pixel, Shade>;
+        default: return sprite_column_kernel<0, Pixel, Shade>;
+    }
+}
+
+inline SpriteBlendKernel pick_sprite_blend_kernel( const size_t tex_size ) {
+    switch ( tex_size ) {
+        case 16: return sprite_blend_column_kernel<4>;
+        case 32: return sprite_blend_column_kernel<5>;
+        case 64: return sprite_blend_column_kernel<6>;
+        case 128: return sprite_blend_column_kernel<7>;
+        case 256: return sprite_blend_column_kernel<8>;
+        default: return sprite_blend_column_kernel<0>;
+    }
+}
+
+#endif
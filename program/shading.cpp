@@ -0,0 +1,26 @@
+#include "shading.h"
+
+#include <cmath>
+
+FogTable::FogTable() {
+    build( Color( 0x000000FF ), 0.0f );
+}
+
+// exponential fog: a surface d away keeps exp(-density * d) of its own colour
+// and the rest comes from the fog colour. a black fog is plain distance shading
+void FogTable::build( const Color fog_color, const float density ) {
+    uint8_t r, g, b, a;
+    fog_color.get_components( r, g, b, a );
+
+    for ( int i = 0; i < FOG_TABLE_SIZE; i++ ) {
+        const float distance = (i + .5f) * (FOG_TABLE_RANGE / FOG_TABLE_SIZE);
+        const uint32_t scale = std::lround( 256 * std::exp( -density * distance ) );
+        const uint32_t fog_amount = 256 - scale;
+
+        levels[ i ] = ShadeLevel {
+            scale,
+            ((uint32_t(r) << 16) | b) * fog_amount,
+            (uint32_t(g) << 16) * fog_amount
+        };
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef SHADING_H
+#define SHADING_H
+
+#include <cstdint>
+#include <array>
+#include <algorithm>
+
+#include "color.h"
+
+#define FOG_TABLE_SIZE 256
+#define FOG_TABLE_RANGE 32.0f // anything further than this uses the last entry
+
+// scales each colour channel by scale / 256 and adds a constant on top. alpha
+// is left alone
+struct ShadeLevel {
+    uint32_t scale;  // 0 - 256
+    uint32_t add_rb; // red and blue to add, already multiplied up by 256
+    uint32_t add_g;  // same for green
+};
+
+// two channels per multiply: red and blue share one 32 bit lane pair, green
+// and alpha the other. neither lane can overflow since scale + the added colour
+// never goes past 256 of a channel
+inline uint32_t shade_pixel( const uint32_t hex, const ShadeLevel& level ) {
+    const uint32_t rb = (hex >> 8) & 0x00FF00FF;
+    const uint32_t ga = hex & 0x00FF00FF;
+    const uint32_t shaded_rb = ((rb * level.scale + level.add_rb) >> 8) & 0x00FF00FF;
+    const uint32_t shaded_g = ((ga * level.scale + level.add_g) >> 8) & 0x00FF0000;
+    return (shaded_rb << 8) | shaded_g | (hex & 0xFF);
+}
+
+inline Color shade_pixel( const Color col, const ShadeLevel& level ) {
+    return Color( shade_pixel( col.get_hex(), level ) );
+}
+
+// distance fog, worked out once up front so the renderer only ever does a
+// table lookup and a couple of integer multiplies per pixel
+class FogTable {
+public:
+    FogTable();
+    void build( const Color fog_color, const float density );
+
+    const ShadeLevel& lookup( const float distance ) const {
+        const int index = distance * (FOG_TABLE_SIZE / FOG_TABLE_RANGE);
+        return levels[ std::max( 0, std::min( index, FOG_TABLE_SIZE - 1 ) ) ];
+    }
+
+private:
+    std::array<ShadeLevel, FOG_TABLE_SIZE> levels;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#include "sprite_cache.h"
+
+#include "render_kernels.h"
+
+size_t ScaledSprite::get_bytes() const {
+    return sizeof( ScaledSprite )
+        + spans.size() * sizeof( TexelSpan )
+        + (span_offsets.size() + pixel_offsets.size()) * sizeof( uint32_t )
+        + pixels.size() * sizeof( Color )
+        + indices.size();
+}
+
+SpriteCache::SpriteCache() : capacity( SPRITE_CACHE_BYTES ), used( 0 ), hits( 0 ), misses( 0 ), evictions( 0 ) {}
+
+void SpriteCache::set_capacity( const size_t bytes ) {
+    capacity = bytes;
+    evict_to( capacity );
+}
+
+void SpriteCache::clear() {
+    entries.clear();
+    lookup.clear();
+    used = 0;
+}
+
+int SpriteCache::quantize_size( const int size ) {
+    if ( size > SPRITE_CACHE_MAX_SIZE ) return size;
+
+    int shift = 0;
+    while ( (size >> shift) >= (1 << SPRITE_CACHE_SIZE_BITS) ) shift++;
+    if ( shift == 0 ) return size;
+
+    return ((size + (1 << (shift - 1))) >> shift) << shift;
+}
+
+const ScaledSprite* SpriteCache::get( Texture& texture, const size_t index, const int size ) {
+    if ( size > SPRITE_CACHE_MAX_SIZE ) return nullptr;
+
+    const uint32_t key = (uint32_t(index) << 16) | uint32_t(size);
+    const auto found = lookup.find( key );
+    if ( found != lookup.end() ) {
+        hits++;
+        entries.splice( entries.begin(), entries, found->second );
+        return &found->second->sprite;
+    }
+
+    misses++;
+
+    // fully opaque is as big as it gets, don't bother scaling what can't fit
+    if ( size_t(size) * size * (sizeof( Color ) + 1) > capacity ) return nullptr;
+
+    entries.push_front( Entry { key, ScaledSprite() } );
+    build( texture, index, size, entries.front().sprite );
+    lookup[ key ] = entries.begin();
+    used += entries.front().sprite.get_bytes();
+    return &entries.front().sprite;
+}
+
+void SpriteCache::trim() {
+    evict_to( capacity );
+}
+
+SpriteCacheStats SpriteCache::get_stats() const {
+    return SpriteCacheStats { hits, misses, evictions, entries.size(), used };
+}
+
+void SpriteCache::reset_stats() {
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+}
+
+// the same texel picks as the sprite column kernel, done once for every row
+void SpriteCache::build( Texture& texture, const size_t index, const int size, ScaledSprite& sprite ) const {
+    const size_t tex_size = texture.get_size();
+    const uint64_t step = texel_step<0>( tex_size, size );
+
+    sprite.size = size;
+    sprite.span_offsets.reserve( size + 1 );
+    sprite.pixel_offsets.reserve( size );
+
+    for ( int x = 0; x < size; x++ ) {
+        const size_t tex_x = size_t(x) * tex_size / size;
+        const Color* texels = texture.get_column_data( index, tex_x );
+        const uint8_t* tex_indices = texture.get_column_indices( index, tex_x );
+        size_t span_count;
+        const TexelSpan* spans = texture.get_column_spans( index, tex_x, span_count );
+
+        sprite.span_offsets.push_back( sprite.spans.size() );
+        sprite.pixel_offsets.push_back( sprite.pixels.size() );
+        for ( size_t s = 0; s < span_count; s++ ) {
+            const int begin = first_row_at_texel( spans[ s ].start, step );
+            const int end = std::min( size, first_row_at_texel( spans[ s ].end, step ) );
+            if ( begin >= end ) continue;
+
+            sprite.spans.push_back( TexelSpan { uint16_t(begin), uint16_t(end) } );
+            for ( int y = begin; y < end; y++ ) {
+                const size_t t = texel_index<0>( step * uint64_t(y), tex_size );
+                sprite.pixels.push_back( texels[ t ] );
+                sprite.indices.push_back( tex_indices[ t ] );
+            }
+        }
+    }
+    sprite.span_offsets.push_back( sprite.spans.size() );
+}
+
+void SpriteCache::evict_to( const size_t bytes ) {
+    while ( used > bytes && !entries.empty() ) {
+        used -= entries.back().sprite.get_bytes();
+        lookup.erase( entries.back().key );
+        entries.pop_back();
+        evictions++;
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef SPRITE_CACHE_H
+#define SPRITE_CACHE_H
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+#include "color.h"
+#include "texture.h"
+
+#define SPRITE_CACHE_BYTES (16 * 1024 * 1024)
+
+// sprite sizes keep this many significant bits once quantised, so sizes under
+// 64 are exact and bigger ones are within about 3%
+#define SPRITE_CACHE_SIZE_BITS 6
+
+// anything bigger is close enough that there won't be many of it, and it's
+// cheaper to scale on the fly than to build and hold on to
+#define SPRITE_CACHE_MAX_SIZE 128
+
+// one sprite already scaled to a size, column by column. only the opaque runs
+// are kept, in rows of the scaled sprite, with their pixels packed one after
+// another so drawing a column is a straight copy
+struct ScaledSprite {
+    int size;
+    std::vector<TexelSpan> spans;
+    std::vector<uint32_t> span_offsets;  // first span of each column, plus one past the end
+    std::vector<uint32_t> pixel_offsets; // first pixel of each column
+    std::vector<Color> pixels;
+    std::vector<uint8_t> indices; // the same pixels as palette indices
+
+    inline const TexelSpan* get_column_spans( const size_t x, size_t& span_count ) const {
+        span_count = span_offsets[ x + 1 ] - span_offsets[ x ];
+        return spans.data() + span_offsets[ x ];
+    }
+
+    size_t get_bytes() const;
+};
+
+struct SpriteCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t entries;
+    size_t bytes;
+};
+
+// scaled sprites keyed by texture index and size, least recently used thrown
+// out first once they take up more than the memory cap
+class SpriteCache {
+public:
+    SpriteCache();
+
+    void set_capacity( const size_t bytes );
+    void clear();
+
+    // rounded so sprites of about the same size share an entry. sizes too big
+    // to cache are left alone
+    static int quantize_size( const int size );
+
+    // scales the sprite on a miss. null if it's too big to cache. nothing is
+    // evicted until trim, so a whole frame's sprites can be fetched up front
+    const ScaledSprite* get( Texture& texture, const size_t index, const int size );
+    // throws out the least recently used entries until it's under the cap
+    void trim();
+
+    SpriteCacheStats get_stats() const;
+    void reset_stats();
+
+private:
+    struct Entry {
+        uint32_t key;
+        ScaledSprite sprite;
+    };
+
+    void build( Texture& texture, const size_t index, const int size, ScaledSprite& sprite ) const;
+    void evict_to( const size_t bytes );
+
+    std::list<Entry> entries; // most recently used first
+    std::unordered_map<uint32_t, std::list<Entry>::iterator> lookup;
+    size_t capacity;
+    size_t used;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+};
+
+#endif
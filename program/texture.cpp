@@ -22,6 +22,8 @@ Texture::Texture( std::string path ) {
         std::cerr << "the texture file must contain N square textures packed horizontally" << std::endl;
     }
 
+    // the renderer walks textures a column at a time, so transpose each one
+    // as it comes in to keep those walks contiguous
     pixels = std::vector<Color>( w * h );
     for ( int i = 0; i < pixels.size(); i++ ) {
         int root_index = i * 4;
@@ -31,10 +33,23 @@ Texture::Texture( std::string path ) {
         b = pixmap[ root_index + 2 ];
         a = pixmap[ root_index + 3 ];
 
-        pixels[ i ] = Color( r, g, b, a );
+        const size_t x = i % w;
+        const size_t y = i / w;
+        pixels[ x * size + y ] = Color( r, g, b, a );
     }
 
     stbi_image_free( pixmap );
+
+    premultiplied.resize( pixels.size() );
+    for ( size_t i = 0; i < pixels.size(); i++ ) {
+        uint8_t r, g, b, a;
+        pixels[ i ].get_components( r, g, b, a );
+        premultiplied[ i ] = Color( (r * a + 127) / 255, (g * a + 127) / 255, (b * a + 127) / 255, a );
+    }
+
+    build_spans( opaque, 0x80, 0xFF );
+    build_spans( solid, 0xFF, 0xFF );
+    build_spans( translucent, 0x01, 0xFE );
 }
 
 size_t Texture::get_size() {
@@ -45,22 +60,71 @@ size_t Texture::get_count() {
     return count;
 }
 
-std::vector<Color> Texture::get_column( size_t col_height, int tex_index, int tex_x ) {
-    size_t img_w, img_h;
-    img_w = size * count;
-    img_h = size;
-    std::vector<Color> column( col_height );
-    for ( int y = 0; y < col_height; y++ ) {
-        size_t pixel_x, pixel_y;
-        pixel_x = tex_index * size + tex_x;
-        pixel_y = (y * size) / col_height;
-        column[ y ] = pixels[ pixel_x + pixel_y * img_w ];
+const Color* Texture::get_column_data( size_t index, size_t x ) const {
+    return &pixels[ (index * size + x) * size ];
+}
+
+Color Texture::get_pixel( size_t x, size_t y, size_t index ) {
+    return pixels[ (index * size + x) * size + y ];
+}
+
+void Texture::add_to_palette( Palette& palette ) const {
+    palette.add_colors( pixels.data(), pixels.size() );
+}
+
+void Texture::build_indices( const Palette& palette ) {
+    indices.resize( pixels.size() );
+    for ( size_t i = 0; i < pixels.size(); i++ ) {
+        const bool transparent = (pixels[ i ].get_hex() & 0xFF) < 0x80;
+        indices[ i ] = transparent ? PALETTE_TRANSPARENT : palette.nearest( pixels[ i ] );
     }
+}
 
-    return column;
+const uint8_t* Texture::get_column_indices( size_t index, size_t x ) const {
+    return &indices[ (index * size + x) * size ];
 }
 
-Color Texture::get_pixel( size_t x, size_t y, size_t index ) {
-    size_t w = size * count;
-    return pixels[ (index * size + x) + y * w ];
+const TexelSpan* Texture::get_column_spans( size_t index, size_t x, size_t& span_count ) const {
+    return get_spans( opaque, index, x, span_count );
+}
+
+const Color* Texture::get_column_premultiplied( size_t index, size_t x ) const {
+    return &premultiplied[ (index * size + x) * size ];
+}
+
+const TexelSpan* Texture::get_column_solid_spans( size_t index, size_t x, size_t& span_count ) const {
+    return get_spans( solid, index, x, span_count );
+}
+
+const TexelSpan* Texture::get_column_translucent_spans( size_t index, size_t x, size_t& span_count ) const {
+    return get_spans( translucent, index, x, span_count );
+}
+
+// alpha range is inclusive
+void Texture::build_spans( ColumnSpans& target, const uint32_t min_alpha, const uint32_t max_alpha ) const {
+    const auto inside = [&]( const Color col ) {
+        const uint32_t alpha = col.get_hex() & 0xFF;
+        return alpha >= min_alpha && alpha <= max_alpha;
+    };
+
+    target.offsets.reserve( count * size + 1 );
+    for ( size_t column = 0; column < count * size; column++ ) {
+        target.offsets.push_back( target.spans.size() );
+
+        const Color* texels = &pixels[ column * size ];
+        size_t y = 0;
+        while ( y < size ) {
+            while ( y < size && !inside( texels[ y ] ) ) y++;
+            const size_t start = y;
+            while ( y < size && inside( texels[ y ] ) ) y++;
+            if ( y > start ) target.spans.push_back( TexelSpan { uint16_t(start), uint16_t(y) } );
+        }
+    }
+    target.offsets.push_back( target.spans.size() );
+}
+
+const TexelSpan* Texture::get_spans( const ColumnSpans& from, size_t index, size_t x, size_t& span_count ) const {
+    const size_t column = index * size + x;
+    span_count = from.offsets[ column + 1 ] - from.offsets[ column ];
+    return from.spans.data() + from.offsets[ column ];
 }
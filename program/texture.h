@@ -4,19 +4,58 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <cstdint>
 
 #include "color.h"
+#include "palette.h"
+
+// a vertical run of texels within one texture column, end exclusive
+struct TexelSpan {
+    uint16_t start;
+    uint16_t end;
+};
+
+// the runs down every column of every texture whose alpha falls in some range
+struct ColumnSpans {
+    std::vector<TexelSpan> spans;
+    std::vector<uint32_t> offsets; // first span of each column, plus one past the end
+};
 
 class Texture {
 public:
     Texture( std::string path );
     size_t get_size();
     size_t get_count();
-    std::vector<Color> get_column( size_t col_height, int tex_index, int tex_x );
+    const Color* get_column_data( size_t index, size_t x ) const;
     Color get_pixel( size_t x, size_t y, size_t index );
 
+    // palette indices for the 8 bit render mode, same layout as the colours
+    void add_to_palette( Palette& palette ) const;
+    void build_indices( const Palette& palette );
+    const uint8_t* get_column_indices( size_t index, size_t x ) const;
+
+    // the opaque runs down a column, worked out at load so sprites can skip
+    // straight past the transparent parts
+    const TexelSpan* get_column_spans( size_t index, size_t x, size_t& span_count ) const;
+
+    // for blended sprites: colours premultiplied by their alpha, and the runs
+    // that are fully opaque or partly see-through. between them they cover
+    // every texel that isn't fully transparent
+    const Color* get_column_premultiplied( size_t index, size_t x ) const;
+    const TexelSpan* get_column_solid_spans( size_t index, size_t x, size_t& span_count ) const;
+    const TexelSpan* get_column_translucent_spans( size_t index, size_t x, size_t& span_count ) const;
+
 private:
-    std::vector<Color> pixels;
+    void build_spans( ColumnSpans& target, const uint32_t min_alpha, const uint32_t max_alpha ) const;
+    const TexelSpan* get_spans( const ColumnSpans& from, size_t index, size_t x, size_t& span_count ) const;
+
+    std::vector<Color> pixels; // each texture stored column by column
+    std::vector<Color> premultiplied;
+    std::vector<uint8_t> indices;
+    ColumnSpans opaque;      // alpha test passes
+    ColumnSpans solid;       // alpha 255
+    ColumnSpans translucent; // alpha 1 - 254
+
     size_t size;
     size_t count;
 };
@@ -0,0 +1,77 @@
+#include "worker_pool.h"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool( const size_t worker_count )
+    : current_job( nullptr ), job_count( 0 ), chunk_size( 1 ), next_chunk( 0 ),
+      busy_workers( 0 ), generation( 0 ), stopping( false ) {
+    for ( size_t i = 0; i < worker_count; i++ ) {
+        workers.emplace_back( &WorkerPool::worker_loop, this );
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    lock.lock();
+    stopping = true;
+    lock.unlock();
+    work_ready.notify_all();
+
+    for ( auto& w : workers ) w.join();
+}
+
+size_t WorkerPool::get_thread_count() const {
+    return workers.size() + 1;
+}
+
+void WorkerPool::parallel_for( const size_t count, const std::function<void( const size_t begin, const size_t end )>& job ) {
+    if ( count == 0 ) return;
+    if ( workers.empty() || count == 1 ) {
+        job( 0, count );
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard( lock );
+        current_job = &job;
+        job_count = count;
+        // a few chunks per thread so uneven work still balances out
+        chunk_size = std::max( size_t(1), count / (get_thread_count() * 4) );
+        next_chunk = 0;
+        busy_workers = workers.size();
+        generation++;
+    }
+    work_ready.notify_all();
+
+    run_chunks();
+
+    std::unique_lock<std::mutex> guard( lock );
+    work_done.wait( guard, [this] { return busy_workers == 0; } );
+    current_job = nullptr;
+}
+
+void WorkerPool::worker_loop() {
+    uint64_t seen_generation = 0;
+
+    while ( true ) {
+        {
+            std::unique_lock<std::mutex> guard( lock );
+            work_ready.wait( guard, [this, seen_generation] { return stopping || generation != seen_generation; } );
+            if ( stopping ) return;
+            seen_generation = generation;
+        }
+
+        run_chunks();
+
+        std::lock_guard<std::mutex> guard( lock );
+        busy_workers--;
+        if ( busy_workers == 0 ) work_done.notify_one();
+    }
+}
+
+void WorkerPool::run_chunks() {
+    while ( true ) {
+        const size_t begin = next_chunk.fetch_add( chunk_size );
+        if ( begin >= job_count ) break;
+        (*current_job)( begin, std::min( begin + chunk_size, job_count ) );
+    }
+}
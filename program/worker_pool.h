@@ -0,0 +1,44 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+// a handful of long lived threads for splitting per-frame work up. the thread
+// calling parallel_for pitches in too, so a pool of 0 workers just runs
+// everything inline
+class WorkerPool {
+public:
+    WorkerPool( const size_t worker_count );
+    ~WorkerPool();
+
+    size_t get_thread_count() const;
+
+    // calls job over chunks of [0, count) until all of it has been covered,
+    // returns once every chunk is done. not reentrant
+    void parallel_for( const size_t count, const std::function<void( const size_t begin, const size_t end )>& job );
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable work_ready;
+    std::condition_variable work_done;
+
+    const std::function<void( const size_t, const size_t )>* current_job;
+    size_t job_count;
+    size_t chunk_size;
+    std::atomic<size_t> next_chunk;
+    size_t busy_workers;
+    uint64_t generation;
+    bool stopping;
+
+    void worker_loop();
+    void run_chunks();
+};
+
+#endif